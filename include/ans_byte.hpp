@@ -99,12 +99,19 @@ std::array<uint16_t, constants::MAX_SIGMA> adjust_freqs(
 struct ans_byte_encode {
     static ans_byte_encode create(const uint8_t* in_u8, size_t n)
     {
-        ans_byte_encode model;
         std::array<uint64_t, constants::MAX_SIGMA> freqs { 0 };
         for (size_t i = 0; i < n; i++) {
             freqs[in_u8[i]]++;
         }
-        model.nfreqs = adjust_freqs(freqs);
+        return create(adjust_freqs(freqs));
+    }
+
+    // build the model from frequencies already normalized to the frame
+    static ans_byte_encode create(
+        const std::array<uint16_t, constants::MAX_SIGMA>& nfreqs)
+    {
+        ans_byte_encode model;
+        model.nfreqs = nfreqs;
         model.frame_size = std::accumulate(
             std::begin(model.nfreqs), std::end(model.nfreqs), 0);
         uint64_t cur_base = 0;
@@ -170,20 +177,27 @@ struct dec_entry {
 
 struct ans_byte_decode {
 
-    static ans_byte_decode load(const uint8_t* in_u8)
+    static std::array<uint32_t, constants::MAX_SIGMA> load_nfreqs(
+        const uint8_t* in_u8)
     {
-        ans_byte_decode model;
+        std::array<uint32_t, constants::MAX_SIGMA> nfreqs;
         auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
-        std::array<uint32_t, constants::MAX_SIGMA> efreqs;
-        interpolative_internal::decode(in_ptr_u32, model.nfreqs.data(),
+        interpolative_internal::decode(in_ptr_u32, nfreqs.data(),
             constants::MAX_SIGMA,
             constants::MAX_FRAME_SIZE + constants::MAX_SIGMA);
-        uint32_t prev = model.nfreqs[0];
+        uint32_t prev = nfreqs[0];
         for (size_t sym = 1; sym < constants::MAX_SIGMA; sym++) {
-            auto cur = model.nfreqs[sym];
-            model.nfreqs[sym] = cur - prev - 1;
+            auto cur = nfreqs[sym];
+            nfreqs[sym] = cur - prev - 1;
             prev = cur;
         }
+        return nfreqs;
+    }
+
+    static ans_byte_decode load(const uint8_t* in_u8)
+    {
+        ans_byte_decode model;
+        model.nfreqs = load_nfreqs(in_u8);
         model.frame_size = std::accumulate(
             std::begin(model.nfreqs), std::end(model.nfreqs), 0ULL);
         model.frame_mask = model.frame_size - 1;
@@ -229,7 +243,7 @@ struct ans_byte_decode {
     uint64_t frame_mask;
     uint64_t frame_log2;
     uint64_t lower_bound;
-    std::vector<dec_entry> table;
+    table_vector<dec_entry> table;
 };
 
 // Compress the the input byte stream. Run 4 states in parallel
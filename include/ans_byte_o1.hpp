@@ -0,0 +1,253 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* Order-1 byte ANS for vbyte streams.
+
+   In vbyte output the distribution of a byte depends mostly on whether
+   the byte in front of it ended a value, i.e. on the high bit of the
+   previous byte. The context of a byte is formed from the high bits of
+   the t_ctx_bits bytes in front of it, so t_ctx_bits = 1 gives two
+   models and t_ctx_bits = 2 also separates the second byte of a value
+   from the later ones. Every context gets an ans_byte model, all scaled
+   to the same frame size so the states share one interval.
+
+   To keep the four states independent the input is cut into four
+   quarters, each coded by its own state with its own context chain
+   starting in context 0. The n % 4 bytes after the last quarter continue
+   the last chain.
+
+   Layout: (uint32 prelude size, ans_byte prelude) of every context,
+   interleaved ANS stream (read backwards as in ans_byte).
+*/
+
+#include "ans_byte.hpp"
+
+template <uint32_t t_ctx_bits> struct ans_byte_o1_encode {
+    static const uint32_t NUM_CTX = 1 << t_ctx_bits;
+
+    static uint32_t next_context(uint32_t ctx, uint8_t sym)
+    {
+        return ((ctx << 1) | (sym >> 7)) & (NUM_CTX - 1);
+    }
+
+    static ans_byte_o1_encode create(const uint8_t* in_u8, size_t n)
+    {
+        ans_byte_o1_encode model;
+        size_t quarter = n / 4;
+        model.contexts.resize(n);
+        std::array<std::array<uint64_t, constants::MAX_SIGMA>, NUM_CTX>
+            freqs {};
+        for (size_t q = 0; q < 4; q++) {
+            size_t end = q == 3 ? n : (q + 1) * quarter;
+            uint32_t ctx = 0;
+            for (size_t i = q * quarter; i < end; i++) {
+                model.contexts[i] = ctx;
+                freqs[ctx][in_u8[i]]++;
+                ctx = next_context(ctx, in_u8[i]);
+            }
+        }
+
+        // unused contexts get a dummy symbol so every model is valid
+        std::array<std::array<uint16_t, constants::MAX_SIGMA>, NUM_CTX>
+            nfreqs;
+        std::array<uint64_t, NUM_CTX> frame_sizes;
+        uint64_t max_frame_size = 0;
+        for (uint32_t c = 0; c < NUM_CTX; c++) {
+            if (*std::max_element(freqs[c].begin(), freqs[c].end()) == 0)
+                freqs[c][0] = 1;
+            nfreqs[c] = adjust_freqs(freqs[c]);
+            frame_sizes[c] = std::accumulate(
+                nfreqs[c].begin(), nfreqs[c].end(), uint64_t(0));
+            max_frame_size = std::max(max_frame_size, frame_sizes[c]);
+        }
+        // frame sizes are powers of two, so scaling up is exact
+        for (uint32_t c = 0; c < NUM_CTX; c++) {
+            for (auto& freq : nfreqs[c])
+                freq *= max_frame_size / frame_sizes[c];
+            model.models[c] = ans_byte_encode::create(nfreqs[c]);
+        }
+        return model;
+    }
+
+    size_t serialize(uint8_t*& out_u8)
+    {
+        auto start = out_u8;
+        for (uint32_t c = 0; c < NUM_CTX; c++) {
+            auto size_u32 = reinterpret_cast<uint32_t*>(out_u8);
+            out_u8 += sizeof(uint32_t);
+            *size_u32 = models[c].serialize(out_u8);
+        }
+        return out_u8 - start;
+    }
+
+    void encode_symbol(
+        uint64_t& state, const uint8_t* in_u8, size_t i, uint8_t*& out_u8)
+    {
+        models[contexts[i]].encode_symbol(state, in_u8[i], out_u8);
+    }
+
+    std::array<ans_byte_encode, NUM_CTX> models;
+    std::vector<uint8_t> contexts;
+};
+
+template <uint32_t t_ctx_bits> struct ans_byte_o1_decode {
+    static const uint32_t NUM_CTX = 1 << t_ctx_bits;
+
+    static ans_byte_o1_decode load(const uint8_t* in_u8)
+    {
+        ans_byte_o1_decode model;
+        std::array<std::array<uint32_t, constants::MAX_SIGMA>, NUM_CTX>
+            nfreqs;
+        for (uint32_t c = 0; c < NUM_CTX; c++) {
+            uint32_t prelude_bytes;
+            memcpy(&prelude_bytes, in_u8, sizeof(uint32_t));
+            in_u8 += sizeof(uint32_t);
+            nfreqs[c] = ans_byte_decode::load_nfreqs(in_u8);
+            in_u8 += prelude_bytes;
+        }
+        uint64_t frame_size = std::accumulate(
+            nfreqs[0].begin(), nfreqs[0].end(), uint64_t(0));
+        model.frame_mask = frame_size - 1;
+        model.frame_log2 = log2(frame_size);
+        model.lower_bound = constants::K * frame_size;
+
+        // the table of context c starts at c * frame_size
+        model.table.resize(NUM_CTX * frame_size);
+        for (uint32_t c = 0; c < NUM_CTX; c++) {
+            auto table = model.table.data() + c * frame_size;
+            uint16_t cur_base = 0;
+            for (size_t sym = 0; sym < constants::MAX_SIGMA; sym++) {
+                auto cur_freq = nfreqs[c][sym];
+                for (uint16_t k = 0; k < cur_freq; k++) {
+                    table[cur_base + k].freq = cur_freq;
+                    table[cur_base + k].sym = sym;
+                    table[cur_base + k].offset = k;
+                }
+                cur_base += cur_freq;
+            }
+        }
+        return model;
+    }
+
+    uint64_t init_state(const uint8_t*& in_u8)
+    {
+        in_u8 -= sizeof(uint64_t);
+        auto in_ptr_u64 = reinterpret_cast<const uint64_t*>(in_u8);
+        return *in_ptr_u64 + lower_bound;
+    }
+
+    table_vector<dec_entry> table;
+    uint64_t frame_mask;
+    uint64_t frame_log2;
+    uint64_t lower_bound;
+};
+
+// the decode state of ans_byte_o1_decode, copied so it can live in
+// registers while the output is written
+struct ans_byte_o1_frame {
+    const dec_entry* table;
+    uint64_t frame_mask;
+    uint64_t frame_log2;
+    uint64_t lower_bound;
+
+    template <uint32_t t_ctx_bits>
+    uint8_t decode_sym(
+        uint64_t& state, uint32_t& ctx, const uint8_t*& in_u8) const
+    {
+        const auto& entry
+            = table[(uint64_t(ctx) << frame_log2) + (state & frame_mask)];
+        state = uint64_t(entry.freq) * (state >> frame_log2)
+            + uint64_t(entry.offset);
+        if (state < lower_bound) {
+            in_u8 -= sizeof(uint32_t);
+            auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
+            state = state << constants::RADIX_LOG2 | uint64_t(*in_ptr_u32);
+        }
+        ctx = ans_byte_o1_encode<t_ctx_bits>::next_context(ctx, entry.sym);
+        return entry.sym;
+    }
+};
+
+template <uint32_t t_ctx_bits>
+size_t ans_byte_o1_compress(
+    void* dst, size_t dstCapacity, const void* src, size_t srcSize)
+{
+    const uint32_t num_states = 4;
+    auto in_u8 = reinterpret_cast<const uint8_t*>(src);
+    auto ans_frame = ans_byte_o1_encode<t_ctx_bits>::create(in_u8, srcSize);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+
+    // serialize model
+    ans_frame.serialize(out_u8);
+
+    std::array<uint64_t, num_states> states;
+    for (uint32_t j = 0; j < num_states; j++)
+        states[j] = ans_frame.models[0].initial_state();
+
+    // the bytes after the last quarter first, then the quarters
+    // interleaved, both in reverse decode order
+    size_t quarter = srcSize / num_states;
+    for (size_t i = srcSize; i != num_states * quarter; i--) {
+        ans_frame.encode_symbol(states[num_states - 1], in_u8, i - 1, out_u8);
+    }
+    for (size_t i = quarter; i != 0; i--) {
+        for (uint32_t j = num_states; j != 0; j--) {
+            ans_frame.encode_symbol(
+                states[j - 1], in_u8, (j - 1) * quarter + i - 1, out_u8);
+        }
+    }
+
+    // flush final state
+    for (uint32_t j = 0; j < num_states; j++)
+        ans_frame.models[0].flush_state(states[j], out_u8);
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+template <uint32_t t_ctx_bits>
+void ans_byte_o1_decompress(
+    void* dst, size_t to_decode, const void* cSrc, size_t cSrcSize)
+{
+    const uint32_t num_states = 4;
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    auto model = ans_byte_o1_decode<t_ctx_bits>::load(in_u8);
+    const ans_byte_o1_frame ans_frame { model.table.data(), model.frame_mask,
+        model.frame_log2, model.lower_bound };
+    in_u8 += cSrcSize;
+
+    std::array<uint64_t, num_states> states;
+    for (uint32_t j = num_states; j != 0; j--)
+        states[j - 1] = model.init_state(in_u8);
+
+    auto out_u8 = reinterpret_cast<uint8_t*>(dst);
+    size_t quarter = to_decode / num_states;
+    uint32_t ctx0 = 0, ctx1 = 0, ctx2 = 0, ctx3 = 0;
+    for (size_t i = 0; i < quarter; i++) {
+        out_u8[i] = ans_frame.decode_sym<t_ctx_bits>(states[0], ctx0, in_u8);
+        out_u8[quarter + i]
+            = ans_frame.decode_sym<t_ctx_bits>(states[1], ctx1, in_u8);
+        out_u8[2 * quarter + i]
+            = ans_frame.decode_sym<t_ctx_bits>(states[2], ctx2, in_u8);
+        out_u8[3 * quarter + i]
+            = ans_frame.decode_sym<t_ctx_bits>(states[3], ctx3, in_u8);
+    }
+    for (size_t i = num_states * quarter; i < to_decode; i++) {
+        out_u8[i] = ans_frame.decode_sym<t_ctx_bits>(states[3], ctx3, in_u8);
+    }
+}
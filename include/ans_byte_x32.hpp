@@ -0,0 +1,293 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* 32-way interleaved byte ANS with a vectorized decoder.
+
+   Same model and prelude as ans_byte, but the input is coded by 32
+   states of 32 bits which are renormalized 16 bits at a time: symbol i
+   belongs to lane i % 32 and a state is kept in [2^15, 2^31). All lanes
+   read their renormalization words from one shared stream in lane order,
+   so the AVX2 decoder handles 8 lanes per vector: gather the decode
+   entries, update the states, and for the lanes that dropped below 2^15
+   load the next words and move them into place with a permutation picked
+   by the lane mask. The scalar decoder reads the same format, the
+   backend is picked at runtime from the CPU features unless forced.
+
+   Layout: uint32 prelude size, ans_byte prelude, the 32 final states,
+   the 16-bit words in decode order, 16 bytes of padding so the decoder
+   can always load 8 words.
+*/
+
+#include <immintrin.h>
+
+#include "ans_byte.hpp"
+
+namespace x32_constants {
+const uint32_t NUM_LANES = 32;
+const uint32_t LOWER_BOUND_LOG2 = 15;
+const uint32_t LOWER_BOUND = 1U << LOWER_BOUND_LOG2;
+const uint32_t WORD_LOG2 = 16;
+const uint32_t PADDING = 16;
+// decode entry: sym << 24 | offset << 12 | freq
+const uint32_t FIELD_MASK = (1U << 12) - 1;
+}
+
+enum class x32_backend { AUTO, SCALAR, AVX2 };
+
+struct ans_byte_x32_encode {
+    static ans_byte_x32_encode create(const uint8_t* in_u8, size_t n)
+    {
+        ans_byte_x32_encode model;
+        model.frame = ans_byte_encode::create(in_u8, n);
+        model.frame_log2 = log2(model.frame.frame_size);
+        return model;
+    }
+
+    void encode_symbol(
+        uint32_t& state, uint8_t sym, std::vector<uint16_t>& words)
+    {
+        const auto& e = frame.table[sym];
+        uint64_t max_state
+            = uint64_t(x32_constants::LOWER_BOUND >> frame_log2) * e.freq
+            << x32_constants::WORD_LOG2;
+        if (state >= max_state) {
+            words.push_back(state & 0xFFFF);
+            state >>= x32_constants::WORD_LOG2;
+        }
+        state = ((state / e.freq) << frame_log2) + (state % e.freq) + e.base;
+    }
+
+    ans_byte_encode frame;
+    uint32_t frame_log2;
+};
+
+struct ans_byte_x32_decode {
+    static ans_byte_x32_decode load(const uint8_t* in_u8)
+    {
+        ans_byte_x32_decode model;
+        auto nfreqs = ans_byte_decode::load_nfreqs(in_u8);
+        uint64_t frame_size
+            = std::accumulate(nfreqs.begin(), nfreqs.end(), uint64_t(0));
+        model.frame_log2 = log2(frame_size);
+        model.table.resize(frame_size);
+        uint32_t cur_base = 0;
+        for (uint32_t sym = 0; sym < constants::MAX_SIGMA; sym++) {
+            for (uint32_t k = 0; k < nfreqs[sym]; k++) {
+                model.table[cur_base + k] = sym << 24 | k << 12 | nfreqs[sym];
+            }
+            cur_base += nfreqs[sym];
+        }
+        return model;
+    }
+
+    table_vector<uint32_t> table;
+    uint32_t frame_log2;
+};
+
+size_t ans_byte_x32_compress(
+    void* dst, size_t dstCapacity, const void* src, size_t srcSize)
+{
+    const uint32_t L = x32_constants::NUM_LANES;
+    auto in_u8 = reinterpret_cast<const uint8_t*>(src);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+    if (srcSize == 0)
+        return 0;
+    auto ans_frame = ans_byte_x32_encode::create(in_u8, srcSize);
+
+    // serialize model
+    auto prelude_bytes = reinterpret_cast<uint32_t*>(out_u8);
+    out_u8 += sizeof(uint32_t);
+    *prelude_bytes = ans_frame.frame.serialize(out_u8);
+
+    // encode in reverse decode order: the partial last round, then the
+    // full rounds, each from the last lane to the first
+    std::array<uint32_t, L> states;
+    states.fill(x32_constants::LOWER_BOUND);
+    std::vector<uint16_t> words;
+    size_t full = srcSize - srcSize % L;
+    for (size_t i = srcSize; i != full; i--) {
+        ans_frame.encode_symbol(states[(i - 1) % L], in_u8[i - 1], words);
+    }
+    for (size_t i = full; i != 0; i--) {
+        ans_frame.encode_symbol(states[(i - 1) % L], in_u8[i - 1], words);
+    }
+
+    memcpy(out_u8, states.data(), sizeof(states));
+    out_u8 += sizeof(states);
+    std::reverse(words.begin(), words.end());
+    if (!words.empty())
+        memcpy(out_u8, words.data(), words.size() * sizeof(uint16_t));
+    out_u8 += words.size() * sizeof(uint16_t);
+    memset(out_u8, 0, x32_constants::PADDING);
+    out_u8 += x32_constants::PADDING;
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+// refills state if it dropped below the lower bound, without a branch as
+// with 32 lanes the refills are hard to predict
+inline void ans_byte_x32_refill(uint32_t& state, const uint16_t*& in_u16)
+{
+    uint32_t refill = state < x32_constants::LOWER_BOUND;
+    uint32_t mask = -refill;
+    uint32_t refilled = state << x32_constants::WORD_LOG2 | *in_u16;
+    state = (state & ~mask) | (refilled & mask);
+    in_u16 += refill;
+}
+
+inline uint8_t ans_byte_x32_decode_sym(
+    const uint32_t* table, uint32_t frame_log2, uint32_t& state)
+{
+    uint32_t e = table[state & ((1U << frame_log2) - 1)];
+    state = (e & x32_constants::FIELD_MASK) * (state >> frame_log2)
+        + ((e >> 12) & x32_constants::FIELD_MASK);
+    return e >> 24;
+}
+
+// decodes to_decode symbols starting at lane 0. the lanes of a round are
+// decoded first and refilled after, so only the refills depend on each
+// other through the word pointer
+void ans_byte_x32_decode_scalar(const ans_byte_x32_decode& model,
+    uint32_t* states, const uint16_t*& in_u16, uint8_t* out_u8,
+    size_t to_decode)
+{
+    const uint32_t L = x32_constants::NUM_LANES;
+    const uint32_t* table = model.table.data();
+    for (size_t i = 0; i < to_decode; i += L) {
+        uint32_t lanes = std::min<size_t>(L, to_decode - i);
+        for (uint32_t j = 0; j < lanes; j++) {
+            out_u8[i + j]
+                = ans_byte_x32_decode_sym(table, model.frame_log2, states[j]);
+        }
+        for (uint32_t j = 0; j < lanes; j++) {
+            ans_byte_x32_refill(states[j], in_u16);
+        }
+    }
+}
+
+// lane permutations for the renormalization words: for every 8 lane mask,
+// lane j takes word k if it is the k-th lane in the mask
+const std::array<std::array<uint32_t, 8>, 256>& ans_byte_x32_permutations()
+{
+    static const auto permutations = [] {
+        std::array<std::array<uint32_t, 8>, 256> p;
+        for (uint32_t mask = 0; mask < 256; mask++) {
+            uint32_t k = 0;
+            for (uint32_t j = 0; j < 8; j++) {
+                p[mask][j] = (mask >> j) & 1 ? k++ : 0;
+            }
+        }
+        return p;
+    }();
+    return permutations;
+}
+
+__attribute__((target("avx2"))) void ans_byte_x32_decode_avx2(
+    const ans_byte_x32_decode& model, uint32_t* states,
+    const uint16_t*& in_u16, uint8_t* out_u8, size_t to_decode)
+{
+    const uint32_t L = x32_constants::NUM_LANES;
+    const auto& permutations = ans_byte_x32_permutations();
+    const int* table = reinterpret_cast<const int*>(model.table.data());
+    const __m128i shift = _mm_cvtsi32_si128(model.frame_log2);
+    const __m256i frame_mask = _mm256_set1_epi32((1U << model.frame_log2) - 1);
+    const __m256i field_mask = _mm256_set1_epi32(x32_constants::FIELD_MASK);
+    const __m256i lower_bound = _mm256_set1_epi32(x32_constants::LOWER_BOUND);
+    const __m256i byte_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    __m256i x[4];
+    for (uint32_t v = 0; v < 4; v++) {
+        x[v] = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(states + 8 * v));
+    }
+    const uint16_t* in = in_u16;
+    size_t rounds = to_decode / L;
+    for (size_t r = 0; r < rounds; r++) {
+        __m256i syms[4];
+        for (uint32_t v = 0; v < 4; v++) {
+            __m256i slot = _mm256_and_si256(x[v], frame_mask);
+            __m256i e = _mm256_i32gather_epi32(table, slot, 4);
+            __m256i freq = _mm256_and_si256(e, field_mask);
+            __m256i offset
+                = _mm256_and_si256(_mm256_srli_epi32(e, 12), field_mask);
+            x[v] = _mm256_add_epi32(
+                _mm256_mullo_epi32(freq, _mm256_srl_epi32(x[v], shift)),
+                offset);
+            syms[v] = _mm256_srli_epi32(e, 24);
+
+            // states are below 2^31, so the signed compare works
+            __m256i refill = _mm256_cmpgt_epi32(lower_bound, x[v]);
+            uint32_t mask
+                = _mm256_movemask_ps(_mm256_castsi256_ps(refill));
+            __m256i words = _mm256_cvtepu16_epi32(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+            words = _mm256_permutevar8x32_epi32(words,
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+                    permutations[mask].data())));
+            __m256i refilled = _mm256_or_si256(
+                _mm256_slli_epi32(x[v], x32_constants::WORD_LOG2), words);
+            x[v] = _mm256_blendv_epi8(x[v], refilled, refill);
+            in += __builtin_popcount(mask);
+        }
+        // 32 x 32 bit symbols to 32 bytes in lane order
+        __m256i s01 = _mm256_packus_epi32(syms[0], syms[1]);
+        __m256i s23 = _mm256_packus_epi32(syms[2], syms[3]);
+        __m256i bytes = _mm256_packus_epi16(s01, s23);
+        bytes = _mm256_permutevar8x32_epi32(bytes, byte_order);
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(out_u8 + r * L), bytes);
+    }
+    for (uint32_t v = 0; v < 4; v++) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(states + 8 * v), x[v]);
+    }
+    in_u16 = in;
+
+    ans_byte_x32_decode_scalar(
+        model, states, in_u16, out_u8 + rounds * L, to_decode - rounds * L);
+}
+
+void ans_byte_x32_decompress(void* dst, size_t to_decode, const void* cSrc,
+    size_t, x32_backend backend = x32_backend::AUTO)
+{
+    if (to_decode == 0)
+        return;
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    uint32_t prelude_bytes;
+    memcpy(&prelude_bytes, in_u8, sizeof(uint32_t));
+    in_u8 += sizeof(uint32_t);
+    auto model = ans_byte_x32_decode::load(in_u8);
+    in_u8 += prelude_bytes;
+
+    std::array<uint32_t, x32_constants::NUM_LANES> states;
+    memcpy(states.data(), in_u8, sizeof(states));
+    auto in_u16 = reinterpret_cast<const uint16_t*>(in_u8 + sizeof(states));
+
+    if (backend == x32_backend::AUTO) {
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        backend = has_avx2 ? x32_backend::AVX2 : x32_backend::SCALAR;
+    }
+    auto out_u8 = reinterpret_cast<uint8_t*>(dst);
+    if (backend == x32_backend::AVX2) {
+        ans_byte_x32_decode_avx2(
+            model, states.data(), in_u16, out_u8, to_decode);
+    } else {
+        ans_byte_x32_decode_scalar(
+            model, states.data(), in_u16, out_u8, to_decode);
+    }
+}
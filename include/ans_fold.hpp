@@ -17,14 +17,20 @@
 
 #pragma once
 
+#include <immintrin.h>
+
 #include "ans_util.hpp"
 #include "interp.hpp"
+#include "transform.hpp"
 #include "util.hpp"
 
 namespace fold_constants {
 const uint64_t RADIX_LOG2 = 32;
 const uint64_t RADIX = 1ULL << RADIX_LOG2;
 const uint64_t K = 16;
+// dec_entry_fold of radices below 8 keeps the number of exception bits
+// above this bit of mapped_num
+const uint32_t EXCEPT_BITS_SHIFT = 27;
 }
 
 struct enc_entry_fold {
@@ -33,50 +39,175 @@ struct enc_entry_fold {
     uint64_t sym_upper_bound;
 };
 
+// the number of digits a value folds: none below 2^(fidelity + radix - 1),
+// then one more for every radix bits above, from the bit length of x
+template <uint32_t fidelity, uint32_t radix>
+inline uint32_t ans_fold_value_digits(uint32_t x)
+{
+    static_assert(
+        radix == 4 || radix == 8 || radix == 16, "radix 4, 8, 16");
+    const uint32_t low_bits = fidelity + radix - 1;
+    uint32_t bits = 32 - __builtin_clz(x | 1);
+    return (std::max(bits, low_bits) - low_bits + radix - 1) / radix;
+}
+
 // maps a 32-bit integer to a reduced address space based on the fidelity
-// parameter this is not veryefficient as we mainly care about decoding speed
-template <uint32_t fidelity> uint32_t ans_fold_mapping(uint32_t x)
+// parameter. every fold drops a digit of radix bits, which becomes an
+// exception. for radix 8 and 16 the exceptions are bytes in the ANS
+// stream, radix 4 packs them into a separate bit stream. a smaller radix
+// gives fewer symbols, so smaller decode tables, but more exception bits
+template <uint32_t fidelity, uint32_t radix = 8>
+uint32_t ans_fold_mapping(uint32_t x)
 {
-    const uint32_t radix = 8;
-    uint32_t radix_mask = ((1 << radix) - 1);
-    size_t offset = 0;
-    size_t thres = 1 << (fidelity + radix - 1);
-    while (x >= thres) {
-        auto digit = x & radix_mask;
-        x = x >> radix;
-        offset = offset + (1 << (fidelity - 1)) * radix_mask;
-    }
-    return x + offset;
+    uint32_t digits = ans_fold_value_digits<fidelity, radix>(x);
+    return (x >> (radix * digits))
+        + digits * (1 << (fidelity - 1)) * ((1 << radix) - 1);
 }
 
-template <uint32_t fidelity>
+// the exception digits are the low radix * digits bits of x. radix 8 and
+// 16 drop at most three bytes, which are written with one unaligned store
+template <uint32_t fidelity, uint32_t radix = 8>
 uint32_t ans_fold_mapping_and_exceptions(uint32_t x, uint8_t*& except_out)
 {
-    const uint32_t radix = 8;
-    uint32_t radix_mask = ((1 << radix) - 1);
-    size_t offset = 0;
+    uint32_t digits = ans_fold_value_digits<fidelity, radix>(x);
+    memcpy(except_out, &x, sizeof(uint32_t));
+    except_out += digits * (radix / 8);
+    return (x >> (radix * digits))
+        + digits * (1 << (fidelity - 1)) * ((1 << radix) - 1);
+}
+
+// maps a block of values ahead of the encode loop: the symbol in the low
+// 24 bits, the number of exception digits above
+template <uint32_t fidelity, uint32_t radix>
+uint32_t ans_fold_map_value(uint32_t x)
+{
+    uint32_t digits = ans_fold_value_digits<fidelity, radix>(x);
+    return ans_fold_mapping<fidelity, radix>(x) | (digits << 24);
+}
+
+// one compare per possible exception digit, unsigned compares as signed
+// compares of values with the top bit flipped
+template <uint32_t fidelity, uint32_t radix>
+__attribute__((target("avx2"))) void ans_fold_map_block_avx2(
+    const uint32_t* in_u32, size_t n, uint32_t* out_u32)
+{
+    const uint32_t low_bits = fidelity + radix - 1;
+    const uint32_t max_digits = (32 - low_bits + radix - 1) / radix;
+    const __m256i flip = _mm256_set1_epi32(0x80000000);
+    const __m256i offset
+        = _mm256_set1_epi32((1 << (fidelity - 1)) * ((1 << radix) - 1));
+    __m256i bounds[max_digits];
+    for (uint32_t k = 0; k < max_digits; k++) {
+        uint32_t bound = (1U << (low_bits + radix * k)) - 1;
+        bounds[k] = _mm256_set1_epi32(0x80000000 ^ bound);
+    }
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(in_u32 + i));
+        __m256i x_flip = _mm256_xor_si256(x, flip);
+        __m256i digits = _mm256_setzero_si256();
+        for (uint32_t k = 0; k < max_digits; k++) {
+            digits = _mm256_sub_epi32(
+                digits, _mm256_cmpgt_epi32(x_flip, bounds[k]));
+        }
+        __m256i mapped = _mm256_add_epi32(
+            _mm256_srlv_epi32(x, _mm256_mullo_epi32(
+                                     digits, _mm256_set1_epi32(radix))),
+            _mm256_mullo_epi32(digits, offset));
+        mapped = _mm256_or_si256(mapped, _mm256_slli_epi32(digits, 24));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_u32 + i), mapped);
+    }
+    for (; i < n; i++)
+        out_u32[i] = ans_fold_map_value<fidelity, radix>(in_u32[i]);
+}
+
+template <uint32_t fidelity, uint32_t radix>
+void ans_fold_map_block(const uint32_t* in_u32, size_t n, uint32_t* out_u32)
+{
+    if (__builtin_cpu_supports("avx2")) {
+        ans_fold_map_block_avx2<fidelity, radix>(in_u32, n, out_u32);
+        return;
+    }
+    for (size_t i = 0; i < n; i++)
+        out_u32[i] = ans_fold_map_value<fidelity, radix>(in_u32[i]);
+}
+
+// undo the fold mapping
+template <uint32_t fidelity, uint32_t radix = 8>
+uint32_t ans_fold_undo_mapping(uint32_t x_plus_offset)
+{
+    uint32_t div = (1 << (fidelity - 1)) * ((1 << radix) - 1);
     size_t thres = 1 << (fidelity + radix - 1);
-    while (x >= thres) {
-        *except_out++ = x & radix_mask;
-        x = x >> radix;
-        offset = offset + (1 << (fidelity - 1)) * radix_mask;
+    if (x_plus_offset < thres)
+        return x_plus_offset;
+    auto output_digits = (x_plus_offset - thres) / div + 1;
+    auto x_org = x_plus_offset - (div * output_digits);
+    return x_org << (radix * output_digits);
+}
+
+// count the number of digits we have to store as exceptions due to the
+// mapping
+template <uint32_t fidelity, uint32_t radix = 8>
+uint32_t ans_fold_exception_digits(uint32_t x_plus_offset)
+{
+    uint32_t div = (1 << (fidelity - 1)) * ((1 << radix) - 1);
+    size_t thres = 1 << (fidelity + radix - 1);
+    if (x_plus_offset < thres)
+        return 0;
+    auto output_digits = (x_plus_offset - thres) / div + 1;
+    return output_digits;
+}
+
+// writes the exception bits of a radix below 8 in input order, mapped is
+// the output of ans_fold_map_block
+template <uint32_t fidelity, uint32_t radix>
+size_t ans_fold_pack_exceptions(const uint32_t* in_u32,
+    const uint32_t* mapped_u32, size_t n, uint8_t* out_u8)
+{
+    auto start = out_u8;
+    uint64_t bits = 0;
+    uint32_t num_bits = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t except_bits = radix * (mapped_u32[i] >> 24);
+        uint64_t except_mask = (uint64_t(1) << except_bits) - 1;
+        bits |= (in_u32[i] & except_mask) << num_bits;
+        num_bits += except_bits;
+        while (num_bits >= 8) {
+            *out_u8++ = bits & 0xFF;
+            bits >>= 8;
+            num_bits -= 8;
+        }
     }
-    return x + offset;
+    if (num_bits != 0)
+        *out_u8++ = bits & 0xFF;
+    return out_u8 - start;
 }
 
-template <uint32_t fidelity> struct ans_fold_encode {
-    static ans_fold_encode create(const uint32_t* in_u32, size_t n)
+struct dec_entry_fold {
+    uint16_t freq;
+    uint16_t offset;
+    uint32_t mapped_num;
+};
+
+template <uint32_t fidelity, uint32_t radix = 8> struct ans_fold_encode {
+    // from the output of ans_fold_map_block. a non-zero table_budget
+    // bounds the decode table, see adjust_freqs_budget
+    static ans_fold_encode create(
+        const uint32_t* mapped_u32, size_t n, size_t table_budget = 0)
     {
-        const uint32_t MAX_SIGMA = 1 << (fidelity + 8 + 1);
+        const uint32_t MAX_SIGMA
+            = ans_fold_mapping<fidelity, radix>(UINT32_MAX) + 1;
         ans_fold_encode model;
         std::vector<uint64_t> freqs(MAX_SIGMA, 0);
         uint32_t max_sym = 0;
         for (size_t i = 0; i < n; i++) {
-            auto mapped_u32 = ans_fold_mapping<fidelity>(in_u32[i]);
-            freqs[mapped_u32]++;
-            max_sym = std::max(mapped_u32, max_sym);
+            uint32_t sym = mapped_u32[i] & 0xFFFFFF;
+            freqs[sym]++;
+            max_sym = std::max(sym, max_sym);
         }
-        model.nfreqs = adjust_freqs(freqs, max_sym, true);
+        model.nfreqs = normalize_freqs(
+            freqs, max_sym, table_budget, sizeof(dec_entry_fold));
         model.frame_size = std::accumulate(
             std::begin(model.nfreqs), std::end(model.nfreqs), 0);
         uint64_t cur_base = 0;
@@ -97,11 +228,16 @@ template <uint32_t fidelity> struct ans_fold_encode {
         return ans_serialize_interp(nfreqs, frame_size, out_u8);
     }
 
-    void encode_symbol(uint64_t& state, uint32_t sym, uint8_t*& out_u8)
+    // x mapped by ans_fold_map_block, exceptions of radix 4 are in the
+    // separate bit stream
+    void encode_symbol(
+        uint64_t& state, uint32_t x, uint32_t mapped, uint8_t*& out_u8)
     {
-        auto mapped_sym
-            = ans_fold_mapping_and_exceptions<fidelity>(sym, out_u8);
-        const auto& e = table[mapped_sym];
+        if (radix % 8 == 0) {
+            memcpy(out_u8, &x, sizeof(uint32_t));
+            out_u8 += (mapped >> 24) * (radix / 8);
+        }
+        const auto& e = table[mapped & 0xFFFFFF];
         if (state >= e.sym_upper_bound) {
             auto out_ptr_u32 = reinterpret_cast<uint32_t*>(out_u8);
             *out_ptr_u32 = state & 0xFFFFFFFF;
@@ -125,12 +261,6 @@ template <uint32_t fidelity> struct ans_fold_encode {
     uint64_t lower_bound;
 };
 
-struct dec_entry_fold {
-    uint16_t freq;
-    uint16_t offset;
-    uint32_t mapped_num;
-};
-
 // undo the fold mapping in a branchless way
 uint32_t ans_fold_undo_mapping(
     const dec_entry_fold& entry, const uint8_t*& in_u8)
@@ -146,39 +276,33 @@ uint32_t ans_fold_undo_mapping(
     return num;
 }
 
-// undo the fold mapping
-template <uint32_t fidelity>
-uint32_t ans_fold_undo_mapping(uint32_t x_plus_offset)
+// undo the fold mapping of a radix below 8, the exception bits are read
+// from the bit stream at except_pos
+inline uint32_t ans_fold_undo_mapping(const dec_entry_fold& entry,
+    const uint8_t* except_u8, uint64_t& except_pos)
 {
-    const uint32_t radix = 8;
-    uint32_t div = (1 << (fidelity - 1)) * ((1 << radix) - 1);
-    size_t thres = 1 << (fidelity + radix - 1);
-    if (x_plus_offset < thres)
-        return x_plus_offset;
-    auto output_bytes = (x_plus_offset - thres) / div + 1;
-    auto x_org = x_plus_offset - (div * output_bytes);
-    return x_org << (radix * output_bytes);
+    const uint32_t shift = fold_constants::EXCEPT_BITS_SHIFT;
+    uint32_t except_bits = entry.mapped_num >> shift;
+    uint32_t x_org = entry.mapped_num & ((1U << shift) - 1);
+    uint64_t except_u64;
+    memcpy(&except_u64, except_u8 + (except_pos >> 3), sizeof(uint64_t));
+    uint64_t except_mask = (uint64_t(1) << except_bits) - 1;
+    uint32_t except = (except_u64 >> (except_pos & 7)) & except_mask;
+    except_pos += except_bits;
+    return (x_org << except_bits) | except;
 }
 
-// count the number of bytes we have to insert into the byte stream due to the
-// mapping
-template <uint32_t fidelity>
-uint32_t ans_fold_exception_bytes(uint32_t x_plus_offset)
-{
-    const uint32_t radix = 8;
-    uint32_t div = (1 << (fidelity - 1)) * ((1 << radix) - 1);
-    size_t thres = 1 << (fidelity + radix - 1);
-    if (x_plus_offset < thres)
-        return 0;
-    auto output_bytes = (x_plus_offset - thres) / div + 1;
-    return output_bytes;
-}
-
-template <uint32_t fidelity> struct ans_fold_decode {
+template <uint32_t fidelity, uint32_t radix = 8> struct ans_fold_decode {
 
     static ans_fold_decode load(const uint8_t* in_u8)
     {
         ans_fold_decode model;
+        if (radix % 8 != 0) {
+            uint32_t except_bytes;
+            memcpy(&except_bytes, in_u8, sizeof(uint32_t));
+            model.except_u8 = in_u8 + sizeof(uint32_t);
+            in_u8 += sizeof(uint32_t) + except_bytes;
+        }
         model.nfreqs = ans_load_interp(in_u8);
         auto max_norm_freq
             = *std::max_element(model.nfreqs.begin(), model.nfreqs.end());
@@ -192,12 +316,18 @@ template <uint32_t fidelity> struct ans_fold_decode {
         uint32_t cur_base = 0;
         for (size_t sym = 0; sym <= max_sym; sym++) {
             auto cur_freq = model.nfreqs[sym];
+            uint32_t except_bits
+                = radix * ans_fold_exception_digits<fidelity, radix>(sym);
+            uint32_t mapped_num = ans_fold_undo_mapping<fidelity, radix>(sym);
+            if (radix % 8 == 0) {
+                mapped_num += (except_bits / 8) << 30;
+            } else {
+                mapped_num = (mapped_num >> except_bits)
+                    + (except_bits << fold_constants::EXCEPT_BITS_SHIFT);
+            }
             for (uint32_t k = 0; k < cur_freq; k++) {
                 model.table[cur_base + k].freq = cur_freq;
-                uint32_t except_bytes = ans_fold_exception_bytes<fidelity>(sym);
-                model.table[cur_base + k].mapped_num
-                    = ans_fold_undo_mapping<fidelity>(sym)
-                    + (except_bytes << 30);
+                model.table[cur_base + k].mapped_num = mapped_num;
                 model.table[cur_base + k].offset = k;
             }
             cur_base += model.nfreqs[sym];
@@ -213,17 +343,24 @@ template <uint32_t fidelity> struct ans_fold_decode {
         return *in_ptr_u64 + lower_bound;
     }
 
+    // as ans_msb_decode::decode_sym
+    template <uint32_t t_frame_log2 = FRAME_LOG2_ANY>
     uint32_t decode_sym(uint64_t& state, const uint8_t*& in_u8)
     {
-        const auto& entry = table[state & frame_mask];
-        state = uint64_t(entry.freq) * (state >> frame_log2)
-            + uint64_t(entry.offset);
-        if (state < lower_bound) {
+        bool fixed = t_frame_log2 != FRAME_LOG2_ANY;
+        uint64_t log2 = fixed ? t_frame_log2 : frame_log2;
+        uint64_t mask = fixed ? (uint64_t(1) << t_frame_log2) - 1 : frame_mask;
+        uint64_t bound = fixed ? constants::K << t_frame_log2 : lower_bound;
+        const auto& entry = table[state & mask];
+        state = uint64_t(entry.freq) * (state >> log2) + uint64_t(entry.offset);
+        if (state < bound) {
             in_u8 -= sizeof(uint32_t);
             auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
             state = state << constants::RADIX_LOG2 | uint64_t(*in_ptr_u32);
         }
-        auto decoded_sym = ans_fold_undo_mapping(entry, in_u8);
+        auto decoded_sym = radix % 8 == 0
+            ? ans_fold_undo_mapping(entry, in_u8)
+            : ans_fold_undo_mapping(entry, except_u8, except_pos);
         return decoded_sym;
     }
 
@@ -232,17 +369,32 @@ template <uint32_t fidelity> struct ans_fold_decode {
     uint64_t frame_mask;
     uint64_t frame_log2;
     uint64_t lower_bound;
-    std::vector<dec_entry_fold> table;
+    table_vector<dec_entry_fold> table;
+    // the exception bit stream of a radix below 8
+    const uint8_t* except_u8 = nullptr;
+    uint64_t except_pos = 0;
 };
 
-template <uint32_t fidelity>
-size_t ans_fold_compress(
-    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+template <uint32_t fidelity, uint32_t radix = 8>
+size_t ans_fold_compress(uint8_t* dst, size_t dstCapacity,
+    const uint32_t* src, size_t srcSize, size_t table_budget = 0)
 {
     auto in_u32 = reinterpret_cast<const uint32_t*>(src);
-    auto ans_frame = ans_fold_encode<fidelity>::create(in_u32, srcSize);
+    // map all values up front, the encode loop only reads the result
+    std::vector<uint32_t> mapped(srcSize);
+    ans_fold_map_block<fidelity, radix>(in_u32, srcSize, mapped.data());
+    auto ans_frame = ans_fold_encode<fidelity, radix>::create(
+        mapped.data(), srcSize, table_budget);
     uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
 
+    // exception bit stream of a radix below 8, in front of the model
+    if (radix % 8 != 0) {
+        uint32_t except_bytes = ans_fold_pack_exceptions<fidelity, radix>(
+            in_u32, mapped.data(), srcSize, out_u8 + sizeof(uint32_t));
+        memcpy(out_u8, &except_bytes, sizeof(uint32_t));
+        out_u8 += sizeof(uint32_t) + except_bytes;
+    }
+
     // serialize model
     ans_frame.serialize(out_u8);
 
@@ -255,19 +407,19 @@ size_t ans_fold_compress(
 
     size_t cur_sym = 0;
     while ((srcSize - cur_sym) % 4 != 0) {
-        ans_frame.encode_symbol(
-            states[0], in_u32[srcSize - cur_sym - 1], out_u8);
+        ans_frame.encode_symbol(states[0], in_u32[srcSize - cur_sym - 1],
+            mapped[srcSize - cur_sym - 1], out_u8);
         cur_sym += 1;
     }
     while (cur_sym != srcSize) {
-        ans_frame.encode_symbol(
-            states[0], in_u32[srcSize - cur_sym - 1], out_u8);
-        ans_frame.encode_symbol(
-            states[1], in_u32[srcSize - cur_sym - 2], out_u8);
-        ans_frame.encode_symbol(
-            states[2], in_u32[srcSize - cur_sym - 3], out_u8);
-        ans_frame.encode_symbol(
-            states[3], in_u32[srcSize - cur_sym - 4], out_u8);
+        ans_frame.encode_symbol(states[0], in_u32[srcSize - cur_sym - 1],
+            mapped[srcSize - cur_sym - 1], out_u8);
+        ans_frame.encode_symbol(states[1], in_u32[srcSize - cur_sym - 2],
+            mapped[srcSize - cur_sym - 2], out_u8);
+        ans_frame.encode_symbol(states[2], in_u32[srcSize - cur_sym - 3],
+            mapped[srcSize - cur_sym - 3], out_u8);
+        ans_frame.encode_symbol(states[3], in_u32[srcSize - cur_sym - 4],
+            mapped[srcSize - cur_sym - 4], out_u8);
         cur_sym += 4;
     }
 
@@ -280,14 +432,12 @@ size_t ans_fold_compress(
     return out_u8 - reinterpret_cast<uint8_t*>(dst);
 }
 
-template <uint32_t fidelity>
-void ans_fold_decompress(
-    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+// the decode loop of ans_fold_decompress for a frame size t_frame_log2
+template <uint32_t fidelity, uint32_t radix, class t_output,
+    uint32_t t_frame_log2>
+void ans_fold_decode_states(ans_fold_decode<fidelity, radix>& ans_frame,
+    uint32_t* dst, size_t to_decode, const uint8_t* in_u8)
 {
-    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
-    auto ans_frame = ans_fold_decode<fidelity>::load(in_u8);
-    in_u8 += cSrcSize;
-
     std::array<uint64_t, 4> states;
     states[3] = ans_frame.init_state(in_u8);
     states[2] = ans_frame.init_state(in_u8);
@@ -296,16 +446,37 @@ void ans_fold_decompress(
 
     size_t cur_idx = 0;
     auto out_u32 = reinterpret_cast<uint32_t*>(dst);
+    t_output output;
     size_t fast_decode = to_decode - (to_decode % 4);
     while (cur_idx != fast_decode) {
-        out_u32[cur_idx] = ans_frame.decode_sym(states[3], in_u8);
-        out_u32[cur_idx + 1] = ans_frame.decode_sym(states[2], in_u8);
-        out_u32[cur_idx + 2] = ans_frame.decode_sym(states[1], in_u8);
-        out_u32[cur_idx + 3] = ans_frame.decode_sym(states[0], in_u8);
+        uint32_t a = ans_frame.template decode_sym<t_frame_log2>(
+            states[3], in_u8);
+        uint32_t b = ans_frame.template decode_sym<t_frame_log2>(
+            states[2], in_u8);
+        uint32_t c = ans_frame.template decode_sym<t_frame_log2>(
+            states[1], in_u8);
+        uint32_t d = ans_frame.template decode_sym<t_frame_log2>(
+            states[0], in_u8);
+        output.store4(out_u32 + cur_idx, a, b, c, d);
         cur_idx += 4;
     }
     while (cur_idx != to_decode) {
-        out_u32[cur_idx] = ans_frame.decode_sym(states[0], in_u8);
+        output.store(out_u32 + cur_idx,
+            ans_frame.template decode_sym<t_frame_log2>(states[0], in_u8));
         cur_idx++;
     }
 }
+
+// t_output writes the decoded values, see transform.hpp
+template <uint32_t fidelity, uint32_t radix = 8,
+    class t_output = identity_output>
+void ans_fold_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    auto ans_frame = ans_fold_decode<fidelity, radix>::load(cSrc);
+    dispatch_frame_log2(ans_frame.frame_log2, [&](auto frame_log2) {
+        ans_fold_decode_states<fidelity, radix, t_output,
+            decltype(frame_log2)::value>(
+            ans_frame, dst, to_decode, cSrc + cSrcSize);
+    });
+}
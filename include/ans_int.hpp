@@ -35,10 +35,22 @@ struct enc_entry_int {
     uint64_t sym_upper_bound;
 };
 
+struct dec_entry_int {
+    uint32_t freq;
+    uint32_t offset;
+    uint32_t sym;
+};
+
+struct dec_entry_int_small {
+    uint16_t freq;
+    uint16_t offset;
+    uint32_t sym;
+};
+
 struct ans_int_encode {
-    static ans_int_encode create(const uint32_t* in_u32, size_t n)
+    static ans_int_encode create(
+        const uint32_t* in_u32, size_t n, size_t table_budget = 0)
     {
-        ans_int_encode model;
         uint32_t max_sym = 0;
         for (size_t i = 0; i < n; i++) {
             max_sym = std::max(in_u32[i], max_sym);
@@ -47,7 +59,15 @@ struct ans_int_encode {
         for (size_t i = 0; i < n; i++) {
             freqs[in_u32[i]]++;
         }
-        model.nfreqs = adjust_freqs(freqs, max_sym, false);
+        return create(freqs, max_sym, table_budget);
+    }
+
+    static ans_int_encode create(const std::vector<uint64_t>& freqs,
+        uint32_t max_sym, size_t table_budget = 0)
+    {
+        ans_int_encode model;
+        model.nfreqs = normalize_freqs(freqs, max_sym, table_budget,
+            sizeof(dec_entry_int_small), sizeof(dec_entry_int));
         model.frame_size = std::accumulate(
             std::begin(model.nfreqs), std::end(model.nfreqs), 0);
         uint64_t cur_base = 0;
@@ -97,18 +117,6 @@ struct ans_int_encode {
     uint64_t lower_bound;
 };
 
-struct dec_entry_int {
-    uint32_t freq;
-    uint32_t offset;
-    uint32_t sym;
-};
-
-struct dec_entry_int_small {
-    uint16_t freq;
-    uint16_t offset;
-    uint32_t sym;
-};
-
 enum dec_table_type { SMALL, LARGE };
 
 struct ans_int_decode {
@@ -185,17 +193,40 @@ struct ans_int_decode {
         return entry.sym;
     }
 
+    // decode_sym that prefetches the table slot of the next step of the
+    // state: the slot if the state is not renormalized and the slot if it
+    // is, whose low bits are then the next 32 bits of the stream. both are
+    // known before the renormalization branch resolves, so the next miss
+    // starts even if that branch is mispredicted
+    template <class t_entry>
+    uint32_t decode_sym_prefetch(uint64_t& state, const uint8_t*& in_u8)
+    {
+        auto tbl = reinterpret_cast<const t_entry*>(table.data());
+        const auto& entry = tbl[state & frame_mask];
+        state = uint64_t(entry.freq) * (state >> frame_log2)
+            + uint64_t(entry.offset);
+        uint32_t next_u32;
+        memcpy(&next_u32, in_u8 - sizeof(uint32_t), sizeof(uint32_t));
+        __builtin_prefetch(tbl + (state & frame_mask));
+        __builtin_prefetch(tbl + (next_u32 & frame_mask));
+        if (state < lower_bound) {
+            in_u8 -= sizeof(uint32_t);
+            state = state << constants::RADIX_LOG2 | uint64_t(next_u32);
+        }
+        return entry.sym;
+    }
+
     std::vector<uint32_t> nfreqs;
     uint64_t frame_size;
     uint64_t frame_mask;
     uint64_t frame_log2;
     uint64_t lower_bound;
     dec_table_type table_type;
-    std::vector<uint8_t> table;
+    table_vector<uint8_t> table;
 };
 
-size_t ans_int_compress(
-    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+size_t ans_int_compress(uint8_t* dst, size_t dstCapacity, const uint32_t* src,
+    size_t srcSize, size_t table_budget = 0)
 {
     const uint32_t num_states = 4;
 #ifdef RECORD_STATS
@@ -203,7 +234,7 @@ size_t ans_int_compress(
 #endif
 
     auto in_u32 = reinterpret_cast<const uint32_t*>(src);
-    auto ans_frame = ans_int_encode::create(in_u32, srcSize);
+    auto ans_frame = ans_int_encode::create(in_u32, srcSize, table_budget);
     uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
 
     // serialize model
@@ -254,6 +285,31 @@ size_t ans_int_compress(
     return out_u8 - reinterpret_cast<uint8_t*>(dst);
 }
 
+// the decode loop of ans_int_decompress, with t_prefetch for tables that
+// do not fit the cache (see use_prefetch)
+template <class t_entry, bool t_prefetch>
+void ans_int_decode_states(ans_int_decode& ans_frame,
+    std::array<uint64_t, 4>& states, const uint8_t* in_u8, uint32_t* out_u32,
+    size_t to_decode)
+{
+    const uint32_t num_states = 4;
+    size_t cur_idx = 0;
+    size_t fast_decode = to_decode - (to_decode % num_states);
+    while (cur_idx != fast_decode) {
+        for (uint32_t j = 0; j < num_states; j++) {
+            out_u32[cur_idx + j] = t_prefetch
+                ? ans_frame.decode_sym_prefetch<t_entry>(states[j], in_u8)
+                : ans_frame.decode_sym<t_entry>(states[j], in_u8);
+        }
+        cur_idx += num_states;
+    }
+    while (cur_idx != to_decode) {
+        out_u32[cur_idx++]
+            = ans_frame.decode_sym<t_entry>(states[num_states - 1], in_u8);
+    }
+}
+
+template <table_prefetch t_prefetch = PREFETCH_AUTO>
 void ans_int_decompress(
     uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
 {
@@ -267,40 +323,23 @@ void ans_int_decompress(
     for (uint32_t i = 0; i < num_states; i++) {
         states[i] = ans_frame.init_state(in_u8);
     }
-    size_t cur_idx = 0;
     auto out_u32 = reinterpret_cast<uint32_t*>(dst);
-    size_t fast_decode = to_decode - (to_decode % num_states);
+    bool prefetch = use_prefetch(t_prefetch, ans_frame.table.size());
     if (ans_frame.table_type == dec_table_type::SMALL) {
-        while (cur_idx != fast_decode) {
-            out_u32[cur_idx]
-                = ans_frame.decode_sym<dec_entry_int_small>(states[0], in_u8);
-            out_u32[cur_idx + 1]
-                = ans_frame.decode_sym<dec_entry_int_small>(states[1], in_u8);
-            out_u32[cur_idx + 2]
-                = ans_frame.decode_sym<dec_entry_int_small>(states[2], in_u8);
-            out_u32[cur_idx + 3]
-                = ans_frame.decode_sym<dec_entry_int_small>(states[3], in_u8);
-            cur_idx += num_states;
-        }
-        while (cur_idx != to_decode) {
-            out_u32[cur_idx++] = ans_frame.decode_sym<dec_entry_int_small>(
-                states[num_states - 1], in_u8);
+        if (prefetch) {
+            ans_int_decode_states<dec_entry_int_small, true>(
+                ans_frame, states, in_u8, out_u32, to_decode);
+        } else {
+            ans_int_decode_states<dec_entry_int_small, false>(
+                ans_frame, states, in_u8, out_u32, to_decode);
         }
     } else {
-        while (cur_idx != fast_decode) {
-            out_u32[cur_idx]
-                = ans_frame.decode_sym<dec_entry_int>(states[0], in_u8);
-            out_u32[cur_idx + 1]
-                = ans_frame.decode_sym<dec_entry_int>(states[1], in_u8);
-            out_u32[cur_idx + 2]
-                = ans_frame.decode_sym<dec_entry_int>(states[2], in_u8);
-            out_u32[cur_idx + 3]
-                = ans_frame.decode_sym<dec_entry_int>(states[3], in_u8);
-            cur_idx += num_states;
-        }
-        while (cur_idx != to_decode) {
-            out_u32[cur_idx++] = ans_frame.decode_sym<dec_entry_int>(
-                states[num_states - 1], in_u8);
+        if (prefetch) {
+            ans_int_decode_states<dec_entry_int, true>(
+                ans_frame, states, in_u8, out_u32, to_decode);
+        } else {
+            ans_int_decode_states<dec_entry_int, false>(
+                ans_frame, states, in_u8, out_u32, to_decode);
         }
     }
-}
\ No newline at end of file
+}
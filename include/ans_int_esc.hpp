@@ -0,0 +1,219 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* ans_int with an escape symbol for rare values.
+
+   Every symbol whose frequency is below a threshold shares a single
+   escape symbol, placed one past the largest symbol kept, and its value
+   is stored vbyte coded in a side channel in input order. The threshold
+   starts at one and doubles until the ans_int decode table of the
+   remaining alphabet fits into budget_kib KiB, so large alphabets keep a
+   cache resident table at the cost of a few escaped values.
+
+   Layout: vbyte side channel length, side channel, ans_int prelude,
+   interleaved ans_int stream (read backwards as in ans_int).
+*/
+
+#include "ans_int.hpp"
+
+template <uint32_t budget_kib> struct ans_int_esc_encode {
+    static ans_int_esc_encode create(const uint32_t* in_u32, size_t n)
+    {
+        ans_int_esc_encode model;
+        uint32_t max_sym = 0;
+        for (size_t i = 0; i < n; i++) {
+            max_sym = std::max(in_u32[i], max_sym);
+        }
+        std::vector<uint64_t> freqs(max_sym + 1, 0);
+        for (size_t i = 0; i < n; i++) {
+            freqs[in_u32[i]]++;
+        }
+
+        uint64_t budget = uint64_t(budget_kib) << 10;
+        std::vector<uint64_t> kept_freqs;
+        for (uint64_t threshold = 1;; threshold *= 2) {
+            uint64_t escaped = 0;
+            uint32_t max_kept = 0;
+            kept_freqs.assign(freqs.size() + 1, 0);
+            for (size_t sym = 0; sym <= max_sym; sym++) {
+                if (freqs[sym] >= threshold) {
+                    kept_freqs[sym] = freqs[sym];
+                    max_kept = sym;
+                } else {
+                    escaped += freqs[sym];
+                }
+            }
+            model.esc_sym = max_kept + 1;
+            if (escaped != 0) {
+                kept_freqs[model.esc_sym] = escaped;
+                kept_freqs.resize(model.esc_sym + 1);
+            } else {
+                kept_freqs.resize(max_kept + 1);
+            }
+            model.frame = ans_int_encode::create(
+                kept_freqs, kept_freqs.size() - 1);
+            auto max_norm_freq = *std::max_element(
+                model.frame.nfreqs.begin(), model.frame.nfreqs.end());
+            uint64_t entry_bytes
+                = max_norm_freq <= std::numeric_limits<uint16_t>::max()
+                ? sizeof(dec_entry_int_small)
+                : sizeof(dec_entry_int);
+            if (model.frame.frame_size * entry_bytes <= budget
+                || escaped == n) {
+                break;
+            }
+        }
+        model.kept_syms = model.esc_sym;
+        return model;
+    }
+
+    bool escaped(uint32_t sym) const
+    {
+        return sym >= kept_syms || frame.nfreqs[sym] == 0;
+    }
+
+    size_t serialize(const uint32_t* in_u32, size_t n, uint8_t*& out_u8)
+    {
+        auto start = out_u8;
+        std::vector<uint8_t> side;
+        for (size_t i = 0; i < n; i++) {
+            if (escaped(in_u32[i]))
+                vbyte_encode_u32(side, in_u32[i]);
+        }
+        vbyte_encode_u32(out_u8, side.size());
+        memcpy(out_u8, side.data(), side.size());
+        out_u8 += side.size();
+        frame.serialize(out_u8);
+        return out_u8 - start;
+    }
+
+    void encode_symbol(uint64_t& state, uint32_t sym, uint8_t*& out_u8)
+    {
+        frame.encode_symbol(state, escaped(sym) ? esc_sym : sym, out_u8);
+    }
+
+    ans_int_encode frame;
+    uint32_t esc_sym;
+    uint32_t kept_syms;
+};
+
+template <uint32_t budget_kib>
+size_t ans_int_esc_compress(
+    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+{
+    const uint32_t num_states = 4;
+    auto in_u32 = reinterpret_cast<const uint32_t*>(src);
+    auto ans_frame = ans_int_esc_encode<budget_kib>::create(in_u32, srcSize);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+
+    // serialize side channel and model
+    ans_frame.serialize(in_u32, srcSize, out_u8);
+
+    std::array<uint64_t, num_states> states;
+
+    // start encoding
+    for (uint32_t i = 0; i < num_states; i++)
+        states[i] = ans_frame.frame.initial_state();
+
+    size_t cur_sym = 0;
+    while ((srcSize - cur_sym) % num_states != 0) {
+        ans_frame.encode_symbol(
+            states[0], in_u32[srcSize - cur_sym - 1], out_u8);
+        cur_sym += 1;
+    }
+    while (cur_sym != srcSize) {
+        ans_frame.encode_symbol(
+            states[0], in_u32[srcSize - cur_sym - 1], out_u8);
+        ans_frame.encode_symbol(
+            states[1], in_u32[srcSize - cur_sym - 2], out_u8);
+        ans_frame.encode_symbol(
+            states[2], in_u32[srcSize - cur_sym - 3], out_u8);
+        ans_frame.encode_symbol(
+            states[3], in_u32[srcSize - cur_sym - 4], out_u8);
+        cur_sym += num_states;
+    }
+
+    // flush final state
+    for (uint32_t i = 0; i < num_states; i++)
+        ans_frame.frame.flush_state(states[i], out_u8);
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+template <class t_entry, bool has_escapes>
+void ans_int_esc_decode(ans_int_decode& ans_frame, const uint8_t* in_u8,
+    const uint8_t* side_u8, uint32_t esc_sym, uint32_t* out_u32,
+    size_t to_decode)
+{
+    const uint32_t num_states = 4;
+    std::array<uint64_t, num_states> states;
+
+    for (uint32_t i = 0; i < num_states; i++) {
+        states[i] = ans_frame.init_state(in_u8);
+    }
+    size_t cur_idx = 0;
+    size_t fast_decode = to_decode - (to_decode % num_states);
+    while (cur_idx != fast_decode) {
+        for (uint32_t j = 0; j < num_states; j++) {
+            uint32_t sym = ans_frame.decode_sym<t_entry>(states[j], in_u8);
+            if (has_escapes && __builtin_expect(sym == esc_sym, 0))
+                sym = vbyte_decode_u32(side_u8);
+            out_u32[cur_idx + j] = sym;
+        }
+        cur_idx += num_states;
+    }
+    while (cur_idx != to_decode) {
+        uint32_t sym
+            = ans_frame.decode_sym<t_entry>(states[num_states - 1], in_u8);
+        if (has_escapes && __builtin_expect(sym == esc_sym, 0))
+            sym = vbyte_decode_u32(side_u8);
+        out_u32[cur_idx++] = sym;
+    }
+}
+
+void ans_int_esc_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    uint32_t side_bytes = vbyte_decode_u32(in_u8);
+    const uint8_t* side_u8 = in_u8;
+    auto ans_frame = ans_int_decode::load(in_u8 + side_bytes);
+    in_u8 = cSrc + cSrcSize;
+
+    uint32_t esc_sym = ans_frame.nfreqs.size() - 1;
+
+    // without escapes the plain ans_int loop is used
+    auto out_u32 = reinterpret_cast<uint32_t*>(dst);
+    bool small = ans_frame.table_type == dec_table_type::SMALL;
+    if (side_bytes == 0) {
+        if (small)
+            ans_int_esc_decode<dec_entry_int_small, false>(
+                ans_frame, in_u8, side_u8, esc_sym, out_u32, to_decode);
+        else
+            ans_int_esc_decode<dec_entry_int, false>(
+                ans_frame, in_u8, side_u8, esc_sym, out_u32, to_decode);
+    } else {
+        if (small)
+            ans_int_esc_decode<dec_entry_int_small, true>(
+                ans_frame, in_u8, side_u8, esc_sym, out_u32, to_decode);
+        else
+            ans_int_esc_decode<dec_entry_int, true>(
+                ans_frame, in_u8, side_u8, esc_sym, out_u32, to_decode);
+    }
+}
@@ -17,8 +17,11 @@
 
 #pragma once
 
+#include <immintrin.h>
+
 #include "ans_util.hpp"
 #include "interp.hpp"
+#include "transform.hpp"
 #include "util.hpp"
 
 #ifdef RECORD_STATS
@@ -38,44 +41,84 @@ struct enc_entry_msb {
     uint64_t sym_upper_bound;
 };
 
+// the number of exception bytes of value x: 0 up to 256, then one more
+// for every byte above. taken from the bit length of x - 1, so 256, 2^16
+// and 2^24 stay in the lower bucket, without a branch
+inline uint32_t ans_msb_value_bytes(uint32_t x)
+{
+    uint32_t bits = 32 - __builtin_clz((x - (x != 0)) | 1);
+    return (std::max(bits, 8U) - 1) / 8;
+}
+
 uint32_t ans_msb_mapping(uint32_t x)
 {
-    if (x <= 256)
-        return x;
-    if (x <= (1 << 16))
-        return (x >> 8) + 256;
-    if (x <= (1 << 24))
-        return (x >> 16) + 512;
-    return (x >> 24) + 768;
+    uint32_t except_bytes = ans_msb_value_bytes(x);
+    return (x >> (8 * except_bytes)) + 256 * except_bytes;
 }
 
+// the exception bytes are the low bytes of x, written with one unaligned
+// store of which only except_bytes are kept
 uint16_t ans_msb_mapping_and_exceptions(uint32_t x, uint8_t*& except_out)
 {
-    if (x <= 256) {
-        return x;
-    }
-    if (x <= (1 << 16)) {
-        // one exception byte
-        *except_out++ = x & 0xFF;
-        return (x >> 8) + 256;
+    uint32_t except_bytes = ans_msb_value_bytes(x);
+    memcpy(except_out, &x, sizeof(uint32_t));
+    except_out += except_bytes;
+    return (x >> (8 * except_bytes)) + 256 * except_bytes;
+}
+
+// maps a block of values ahead of the encode loop: the symbol in the low
+// 24 bits, the number of exception bytes above. the avx2 version counts
+// the exception bytes with three compares per lane
+inline uint32_t ans_msb_map_value(uint32_t x)
+{
+    uint32_t except_bytes = ans_msb_value_bytes(x);
+    return ans_msb_mapping(x) | (except_bytes << 24);
+}
+
+__attribute__((target("avx2"))) void ans_msb_map_block_avx2(
+    const uint32_t* in_u32, size_t n, uint32_t* out_u32)
+{
+    // unsigned compares as signed compares of values with the top bit
+    // flipped
+    const __m256i flip = _mm256_set1_epi32(0x80000000);
+    const __m256i bound1 = _mm256_set1_epi32(0x80000000 ^ (1U << 8));
+    const __m256i bound2 = _mm256_set1_epi32(0x80000000 ^ (1U << 16));
+    const __m256i bound3 = _mm256_set1_epi32(0x80000000 ^ (1U << 24));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(in_u32 + i));
+        __m256i x_flip = _mm256_xor_si256(x, flip);
+        // every compare gives -1 for a lane above its bound
+        __m256i except_bytes = _mm256_sub_epi32(
+            _mm256_setzero_si256(), _mm256_cmpgt_epi32(x_flip, bound1));
+        except_bytes = _mm256_sub_epi32(
+            except_bytes, _mm256_cmpgt_epi32(x_flip, bound2));
+        except_bytes = _mm256_sub_epi32(
+            except_bytes, _mm256_cmpgt_epi32(x_flip, bound3));
+        __m256i mapped = _mm256_add_epi32(
+            _mm256_srlv_epi32(x, _mm256_slli_epi32(except_bytes, 3)),
+            _mm256_slli_epi32(except_bytes, 8));
+        mapped = _mm256_or_si256(mapped, _mm256_slli_epi32(except_bytes, 24));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_u32 + i), mapped);
     }
-    if (x <= (1 << 24)) {
-        // two exception byte
-        *except_out++ = x & 0xFF;
-        *except_out++ = (x >> 8) & 0xFF;
-        return (x >> 16) + 512;
+    for (; i < n; i++)
+        out_u32[i] = ans_msb_map_value(in_u32[i]);
+}
+
+void ans_msb_map_block(const uint32_t* in_u32, size_t n, uint32_t* out_u32)
+{
+    if (__builtin_cpu_supports("avx2")) {
+        ans_msb_map_block_avx2(in_u32, n, out_u32);
+        return;
     }
-    // three exception byte
-    *except_out++ = x & 0xFF;
-    *except_out++ = (x >> 8) & 0xFF;
-    *except_out++ = (x >> 16) & 0xFF;
-    return (x >> 24) + 768;
+    for (size_t i = 0; i < n; i++)
+        out_u32[i] = ans_msb_map_value(in_u32[i]);
 }
 
 struct ans_msb_encode {
     static ans_msb_encode create(const uint32_t* in_u32, size_t n)
     {
-        ans_msb_encode model;
         std::vector<uint64_t> freqs(msb_constants::MAX_SIGMA, 0);
         uint32_t max_sym = 0;
         for (size_t i = 0; i < n; i++) {
@@ -83,12 +126,34 @@ struct ans_msb_encode {
             freqs[mapped_u32]++;
             max_sym = std::max(mapped_u32, max_sym);
         }
-        model.nfreqs = adjust_freqs(freqs, max_sym, true);
+        return create(adjust_freqs(freqs, max_sym, true));
+    }
+
+    // from the output of ans_msb_map_block. a non-zero table_budget bounds
+    // the decode table, see adjust_freqs_budget
+    static ans_msb_encode create_mapped(const uint32_t* mapped_u32, size_t n,
+        size_t table_budget = 0, size_t entry_bytes = 0)
+    {
+        std::vector<uint64_t> freqs(msb_constants::MAX_SIGMA, 0);
+        uint32_t max_sym = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t sym = mapped_u32[i] & 0xFFFFFF;
+            freqs[sym]++;
+            max_sym = std::max(sym, max_sym);
+        }
+        return create(
+            normalize_freqs(freqs, max_sym, table_budget, entry_bytes));
+    }
+
+    static ans_msb_encode create(const std::vector<uint32_t>& nfreqs)
+    {
+        ans_msb_encode model;
+        model.nfreqs = nfreqs;
         model.frame_size = std::accumulate(
             std::begin(model.nfreqs), std::end(model.nfreqs), 0);
         uint64_t cur_base = 0;
         uint64_t tmp = constants::K * constants::RADIX;
-        model.table.resize(max_sym + 1);
+        model.table.resize(model.nfreqs.size());
         for (size_t sym = 0; sym < model.nfreqs.size(); sym++) {
             model.table[sym].freq = model.nfreqs[sym];
             model.table[sym].base = cur_base;
@@ -107,6 +172,20 @@ struct ans_msb_encode {
     void encode_symbol(uint64_t& state, uint32_t sym, uint8_t*& out_u8)
     {
         auto mapped_sym = ans_msb_mapping_and_exceptions(sym, out_u8);
+        encode_mapped(state, mapped_sym, out_u8);
+    }
+
+    // sym already mapped by ans_msb_map_block
+    void encode_symbol(
+        uint64_t& state, uint32_t x, uint32_t mapped, uint8_t*& out_u8)
+    {
+        memcpy(out_u8, &x, sizeof(uint32_t));
+        out_u8 += mapped >> 24;
+        encode_mapped(state, mapped & 0xFFFFFF, out_u8);
+    }
+
+    void encode_mapped(uint64_t& state, uint32_t mapped_sym, uint8_t*& out_u8)
+    {
         const auto& e = table[mapped_sym];
         if (state >= e.sym_upper_bound) {
             auto out_ptr_u32 = reinterpret_cast<uint32_t*>(out_u8);
@@ -177,9 +256,14 @@ uint32_t ans_msb_exception_bytes(uint32_t x)
 
 struct ans_msb_decode {
     static ans_msb_decode load(const uint8_t* in_u8)
+    {
+        return create(ans_load_interp(in_u8));
+    }
+
+    static ans_msb_decode create(const std::vector<uint32_t>& nfreqs)
     {
         ans_msb_decode model;
-        model.nfreqs = ans_load_interp(in_u8);
+        model.nfreqs = nfreqs;
         model.frame_size = std::accumulate(
             std::begin(model.nfreqs), std::end(model.nfreqs), 0);
         model.frame_mask = model.frame_size - 1;
@@ -210,12 +294,18 @@ struct ans_msb_decode {
         return *in_ptr_u64 + lower_bound;
     }
 
+    // with a frame size fixed at compile time unless t_frame_log2 is
+    // FRAME_LOG2_ANY, see dispatch_frame_log2
+    template <uint32_t t_frame_log2 = FRAME_LOG2_ANY>
     uint32_t decode_sym(uint64_t& state, const uint8_t*& in_u8)
     {
-        const auto& entry = table[state & frame_mask];
-        state = uint64_t(entry.freq) * (state >> frame_log2)
-            + uint64_t(entry.offset);
-        if (state < lower_bound) {
+        bool fixed = t_frame_log2 != FRAME_LOG2_ANY;
+        uint64_t log2 = fixed ? t_frame_log2 : frame_log2;
+        uint64_t mask = fixed ? (uint64_t(1) << t_frame_log2) - 1 : frame_mask;
+        uint64_t bound = fixed ? constants::K << t_frame_log2 : lower_bound;
+        const auto& entry = table[state & mask];
+        state = uint64_t(entry.freq) * (state >> log2) + uint64_t(entry.offset);
+        if (state < bound) {
             in_u8 -= sizeof(uint32_t);
             auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
             state = state << constants::RADIX_LOG2 | uint64_t(*in_ptr_u32);
@@ -229,11 +319,13 @@ struct ans_msb_decode {
     uint64_t frame_mask;
     uint64_t frame_log2;
     uint64_t lower_bound;
-    std::vector<dec_entry_msb> table;
+    table_vector<dec_entry_msb> table;
 };
 
-size_t ans_msb_compress(
-    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+// entry_bytes is the decode table entry size the table_budget is spent on
+size_t ans_msb_compress(uint8_t* dst, size_t dstCapacity, const uint32_t* src,
+    size_t srcSize, size_t table_budget = 0,
+    size_t entry_bytes = sizeof(dec_entry_msb))
 {
     const uint32_t num_states = 4;
 #ifdef RECORD_STATS
@@ -241,7 +333,11 @@ size_t ans_msb_compress(
 #endif
 
     auto in_u32 = reinterpret_cast<const uint32_t*>(src);
-    auto ans_frame = ans_msb_encode::create(in_u32, srcSize);
+    // map all values up front, the encode loop only reads the result
+    std::vector<uint32_t> mapped(srcSize);
+    ans_msb_map_block(in_u32, srcSize, mapped.data());
+    auto ans_frame = ans_msb_encode::create_mapped(
+        mapped.data(), srcSize, table_budget, entry_bytes);
     uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
 
     // serialize model
@@ -261,19 +357,19 @@ size_t ans_msb_compress(
 
     size_t cur_sym = 0;
     while ((srcSize - cur_sym) % num_states != 0) {
-        ans_frame.encode_symbol(
-            states[0], in_u32[srcSize - cur_sym - 1], out_u8);
+        ans_frame.encode_symbol(states[0], in_u32[srcSize - cur_sym - 1],
+            mapped[srcSize - cur_sym - 1], out_u8);
         cur_sym += 1;
     }
     while (cur_sym != srcSize) {
-        ans_frame.encode_symbol(
-            states[0], in_u32[srcSize - cur_sym - 1], out_u8);
-        ans_frame.encode_symbol(
-            states[1], in_u32[srcSize - cur_sym - 2], out_u8);
-        ans_frame.encode_symbol(
-            states[2], in_u32[srcSize - cur_sym - 3], out_u8);
-        ans_frame.encode_symbol(
-            states[3], in_u32[srcSize - cur_sym - 4], out_u8);
+        ans_frame.encode_symbol(states[0], in_u32[srcSize - cur_sym - 1],
+            mapped[srcSize - cur_sym - 1], out_u8);
+        ans_frame.encode_symbol(states[1], in_u32[srcSize - cur_sym - 2],
+            mapped[srcSize - cur_sym - 2], out_u8);
+        ans_frame.encode_symbol(states[2], in_u32[srcSize - cur_sym - 3],
+            mapped[srcSize - cur_sym - 3], out_u8);
+        ans_frame.encode_symbol(states[3], in_u32[srcSize - cur_sym - 4],
+            mapped[srcSize - cur_sym - 4], out_u8);
         cur_sym += num_states;
     }
 
@@ -291,14 +387,12 @@ size_t ans_msb_compress(
     return out_u8 - reinterpret_cast<uint8_t*>(dst);
 }
 
-void ans_msb_decompress(
-    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+// the decode loop of ans_msb_decode_stream for a frame size t_frame_log2
+template <class t_output, uint32_t t_frame_log2>
+void ans_msb_decode_states(ans_msb_decode& ans_frame, uint32_t* dst,
+    size_t to_decode, const uint8_t* in_u8)
 {
     const uint32_t num_states = 4;
-    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
-    auto ans_frame = ans_msb_decode::load(in_u8);
-    in_u8 += cSrcSize;
-
     std::array<uint64_t, num_states> states;
 
     for (uint32_t i = 0; i < num_states; i++) {
@@ -307,16 +401,38 @@ void ans_msb_decompress(
 
     size_t cur_idx = 0;
     auto out_u32 = reinterpret_cast<uint32_t*>(dst);
+    t_output output;
     size_t fast_decode = to_decode - (to_decode % num_states);
     while (cur_idx != fast_decode) {
-        out_u32[cur_idx] = ans_frame.decode_sym(states[0], in_u8);
-        out_u32[cur_idx + 1] = ans_frame.decode_sym(states[1], in_u8);
-        out_u32[cur_idx + 2] = ans_frame.decode_sym(states[2], in_u8);
-        out_u32[cur_idx + 3] = ans_frame.decode_sym(states[3], in_u8);
+        uint32_t a = ans_frame.decode_sym<t_frame_log2>(states[0], in_u8);
+        uint32_t b = ans_frame.decode_sym<t_frame_log2>(states[1], in_u8);
+        uint32_t c = ans_frame.decode_sym<t_frame_log2>(states[2], in_u8);
+        uint32_t d = ans_frame.decode_sym<t_frame_log2>(states[3], in_u8);
+        output.store4(out_u32 + cur_idx, a, b, c, d);
         cur_idx += num_states;
     }
     while (cur_idx != to_decode) {
-        out_u32[cur_idx++]
-            = ans_frame.decode_sym(states[num_states - 1], in_u8);
+        output.store(out_u32 + cur_idx++,
+            ans_frame.decode_sym<t_frame_log2>(states[num_states - 1], in_u8));
     }
-}
\ No newline at end of file
+}
+
+// decodes the ANS stream ending at in_u8 with a loaded model. t_output
+// writes the decoded values, see transform.hpp
+template <class t_output = identity_output>
+void ans_msb_decode_stream(ans_msb_decode& ans_frame, uint32_t* dst,
+    size_t to_decode, const uint8_t* in_u8)
+{
+    dispatch_frame_log2(ans_frame.frame_log2, [&](auto frame_log2) {
+        ans_msb_decode_states<t_output, decltype(frame_log2)::value>(
+            ans_frame, dst, to_decode, in_u8);
+    });
+}
+
+template <class t_output = identity_output>
+void ans_msb_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    auto ans_frame = ans_msb_decode::load(cSrc);
+    ans_msb_decode_stream<t_output>(ans_frame, dst, to_decode, cSrc + cSrcSize);
+}
@@ -0,0 +1,160 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* ans_msb decoding with 8 byte table entries and no data dependent
+   branches.
+
+   dec_entry_msb stores freq and offset as uint32, 12 bytes per entry.
+   ans_msb normalizes with require_u16, so every frequency, and every
+   offset below it, fits a uint16 and an entry packs into 8 bytes: freq,
+   offset, and the value with the number of exception bytes in its top
+   two bits as in ans_msb.
+
+   Renormalization always loads the next 32 bits of the stream and keeps
+   them only if the state fell below the lower bound. The shift of the
+   state, the mask of the loaded bits and the mask of the exception bytes
+   come from constexpr tables indexed by the comparison and the exception
+   count, so the loop compiles to cmov/shift sequences instead of a branch
+   that mispredicts whenever the renormalization points are irregular.
+
+   The stream is the one of ans_msb_compress, only the decoder differs.
+*/
+
+#include "ans_msb.hpp"
+
+namespace msb_compact_constants {
+// indexed by whether the state is renormalized
+constexpr std::array<uint32_t, 2> RENORM_SHIFT = { 0, 32 };
+constexpr std::array<uint64_t, 2> RENORM_MASK = { 0x0, 0xFFFFFFFF };
+// indexed by the number of exception bytes
+constexpr std::array<uint32_t, 4> EXCEPT_MASK
+    = { 0x0, 0xFF, 0xFFFF, 0xFFFFFF };
+}
+
+struct dec_entry_msb_compact {
+    uint16_t freq;
+    uint16_t offset;
+    uint32_t mapped_num;
+};
+
+static_assert(sizeof(dec_entry_msb_compact) == 8, "8 byte decode entries");
+
+struct ans_msb_compact_decode {
+    static ans_msb_compact_decode load(const uint8_t* in_u8)
+    {
+        ans_msb_compact_decode model;
+        auto nfreqs = ans_load_interp(in_u8);
+        uint64_t frame_size
+            = std::accumulate(std::begin(nfreqs), std::end(nfreqs), 0);
+        model.frame_mask = frame_size - 1;
+        model.frame_log2 = log2(frame_size);
+        model.lower_bound = constants::K * frame_size;
+        model.table.resize(frame_size);
+        uint32_t cur_base = 0;
+        for (size_t sym = 0; sym < nfreqs.size(); sym++) {
+            auto cur_freq = nfreqs[sym];
+            uint32_t except_bytes = ans_msb_exception_bytes(sym);
+            for (uint32_t k = 0; k < cur_freq; k++) {
+                model.table[cur_base + k].freq = cur_freq;
+                model.table[cur_base + k].offset = k;
+                model.table[cur_base + k].mapped_num
+                    = ans_msb_undo_mapping(sym) + (except_bytes << 30);
+            }
+            cur_base += cur_freq;
+        }
+        return model;
+    }
+
+    uint64_t init_state(const uint8_t*& in_u8) const
+    {
+        in_u8 -= sizeof(uint64_t);
+        auto in_ptr_u64 = reinterpret_cast<const uint64_t*>(in_u8);
+        return *in_ptr_u64 + lower_bound;
+    }
+
+    // as ans_msb_decode::decode_sym
+    template <uint32_t t_frame_log2 = FRAME_LOG2_ANY>
+    uint32_t decode_sym(uint64_t& state, const uint8_t*& in_u8) const
+    {
+        using namespace msb_compact_constants;
+        bool fixed = t_frame_log2 != FRAME_LOG2_ANY;
+        uint64_t log2 = fixed ? t_frame_log2 : frame_log2;
+        uint64_t mask = fixed ? (uint64_t(1) << t_frame_log2) - 1 : frame_mask;
+        uint64_t bound = fixed ? constants::K << t_frame_log2 : lower_bound;
+        const auto& entry = table[state & mask];
+        state = uint64_t(entry.freq) * (state >> log2) + uint64_t(entry.offset);
+        uint32_t renorm = state < bound;
+        in_u8 -= renorm * sizeof(uint32_t);
+        uint32_t next_u32;
+        memcpy(&next_u32, in_u8, sizeof(uint32_t));
+        state = (state << RENORM_SHIFT[renorm])
+            | (uint64_t(next_u32) & RENORM_MASK[renorm]);
+
+        uint32_t except_bytes = entry.mapped_num >> 30;
+        in_u8 -= except_bytes;
+        uint32_t except_u32;
+        memcpy(&except_u32, in_u8, sizeof(uint32_t));
+        return (entry.mapped_num & 0x3FFFFFFF)
+            + (except_u32 & EXCEPT_MASK[except_bytes]);
+    }
+
+    uint64_t frame_mask;
+    uint64_t frame_log2;
+    uint64_t lower_bound;
+    table_vector<dec_entry_msb_compact> table;
+};
+
+// the decode loop of ans_msb_compact_decompress for a frame size
+// t_frame_log2
+template <class t_output, uint32_t t_frame_log2>
+void ans_msb_compact_decode_states(const ans_msb_compact_decode& ans_frame,
+    uint32_t* dst, size_t to_decode, const uint8_t* in_u8)
+{
+    const uint32_t num_states = 4;
+    std::array<uint64_t, num_states> states;
+    for (uint32_t i = 0; i < num_states; i++)
+        states[i] = ans_frame.init_state(in_u8);
+
+    size_t cur_idx = 0;
+    t_output output;
+    size_t fast_decode = to_decode - (to_decode % num_states);
+    while (cur_idx != fast_decode) {
+        uint32_t a = ans_frame.decode_sym<t_frame_log2>(states[0], in_u8);
+        uint32_t b = ans_frame.decode_sym<t_frame_log2>(states[1], in_u8);
+        uint32_t c = ans_frame.decode_sym<t_frame_log2>(states[2], in_u8);
+        uint32_t d = ans_frame.decode_sym<t_frame_log2>(states[3], in_u8);
+        output.store4(dst + cur_idx, a, b, c, d);
+        cur_idx += num_states;
+    }
+    while (cur_idx != to_decode) {
+        output.store(dst + cur_idx++,
+            ans_frame.decode_sym<t_frame_log2>(states[num_states - 1], in_u8));
+    }
+}
+
+template <class t_output = identity_output>
+void ans_msb_compact_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    const auto ans_frame = ans_msb_compact_decode::load(cSrc);
+    dispatch_frame_log2(ans_frame.frame_log2, [&](auto frame_log2) {
+        ans_msb_compact_decode_states<t_output, decltype(frame_log2)::value>(
+            ans_frame, dst, to_decode, cSrc + cSrcSize);
+    });
+}
@@ -0,0 +1,262 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* ans_msb with entropy coded exception bytes.
+
+   The msb buckets are coded as in ans_msb, but the exception bytes go to
+   separate streams instead of being stored raw between the ANS words.
+   Every (bucket, byte position) slot with at least MIN_SLOT_BYTES
+   exception bytes gets its own stream, the bytes of all other slots are
+   pooled into one stream per byte position. Each stream is compressed
+   with ans_byte and kept raw if that does not make it smaller. The
+   decoder expands all streams first and then reads the bytes of a value
+   through a per slot cursor. If coding removes less than 1/MIN_GAIN of
+   the exception bytes the input is stored as plain ans_msb instead, which
+   decodes faster.
+
+   Layout: flag byte (0 = plain ans_msb follows), vbyte number of own
+   slots, their slot ids, vbyte raw and stored size of each stream, the
+   streams, ans_msb prelude, ans_msb stream (read backwards as in
+   ans_msb).
+*/
+
+#include "ans_byte.hpp"
+#include "ans_msb.hpp"
+
+namespace msb_ex_constants {
+const uint32_t MAX_EXCEPT = 3;
+const uint32_t NUM_SLOTS = msb_constants::MAX_SIGMA * MAX_EXCEPT;
+const size_t MIN_SLOT_BYTES = 4096;
+const size_t MIN_GAIN = 16;
+}
+
+size_t ans_msb_ex_compress(
+    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+{
+    const uint32_t num_states = 4;
+    const uint32_t MAX_EXCEPT = msb_ex_constants::MAX_EXCEPT;
+    auto in_u32 = reinterpret_cast<const uint32_t*>(src);
+    auto ans_frame = ans_msb_encode::create(in_u32, srcSize);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+
+    // (1) assign slots to streams
+    std::vector<size_t> slot_bytes(msb_ex_constants::NUM_SLOTS, 0);
+    for (size_t i = 0; i < srcSize; i++) {
+        auto sym = ans_msb_mapping(in_u32[i]);
+        auto except_bytes = ans_msb_exception_bytes(sym);
+        for (uint32_t j = 0; j < except_bytes; j++)
+            slot_bytes[sym * MAX_EXCEPT + j]++;
+    }
+    std::vector<uint32_t> slot_stream(msb_ex_constants::NUM_SLOTS);
+    std::vector<uint32_t> own_slots;
+    for (uint32_t slot = 0; slot < msb_ex_constants::NUM_SLOTS; slot++) {
+        if (slot_bytes[slot] >= msb_ex_constants::MIN_SLOT_BYTES) {
+            slot_stream[slot] = MAX_EXCEPT + own_slots.size();
+            own_slots.push_back(slot);
+        } else {
+            slot_stream[slot] = slot % MAX_EXCEPT;
+        }
+    }
+
+    // (2) split the exception bytes in input order
+    std::vector<std::vector<uint8_t>> streams(MAX_EXCEPT + own_slots.size());
+    for (size_t i = 0; i < srcSize; i++) {
+        uint8_t except[4];
+        uint8_t* except_out = except;
+        auto sym = ans_msb_mapping_and_exceptions(in_u32[i], except_out);
+        for (uint32_t j = 0; j < except_out - except; j++)
+            streams[slot_stream[sym * MAX_EXCEPT + j]].push_back(except[j]);
+    }
+
+    // (3) compress each stream, keep it raw if that is smaller
+    std::vector<std::vector<uint8_t>> stored(streams.size());
+    size_t raw_total = 0;
+    size_t stored_total = 0;
+    for (size_t s = 0; s < streams.size(); s++) {
+        const auto& bytes = streams[s];
+        stored[s].resize(bytes.size() * 2 + 4096);
+        size_t stored_bytes = 0;
+        if (bytes.size() != 0) {
+            stored_bytes = ans_byte_compress(stored[s].data(),
+                stored[s].size(), bytes.data(), bytes.size());
+        }
+        if (stored_bytes >= bytes.size()) {
+            stored[s] = bytes;
+        } else {
+            stored[s].resize(stored_bytes);
+        }
+        raw_total += bytes.size();
+        stored_total += stored[s].size();
+    }
+    if (raw_total - stored_total <= raw_total / msb_ex_constants::MIN_GAIN) {
+        *out_u8++ = 0;
+        return 1 + ans_msb_compress(out_u8, dstCapacity - 1, src, srcSize);
+    }
+
+    *out_u8++ = 1;
+
+    vbyte_encode_u32(out_u8, own_slots.size());
+    for (auto slot : own_slots)
+        vbyte_encode_u32(out_u8, slot);
+    for (size_t s = 0; s < streams.size(); s++) {
+        vbyte_encode_u32(out_u8, streams[s].size());
+        vbyte_encode_u32(out_u8, stored[s].size());
+    }
+    for (const auto& bytes : stored) {
+        memcpy(out_u8, bytes.data(), bytes.size());
+        out_u8 += bytes.size();
+    }
+
+    // (4) code the buckets
+    ans_frame.serialize(out_u8);
+
+    std::array<uint64_t, num_states> states;
+    for (uint32_t i = 0; i < num_states; i++)
+        states[i] = ans_frame.initial_state();
+
+    size_t cur_sym = 0;
+    while ((srcSize - cur_sym) % num_states != 0) {
+        ans_frame.encode_mapped(states[0],
+            ans_msb_mapping(in_u32[srcSize - cur_sym - 1]), out_u8);
+        cur_sym += 1;
+    }
+    while (cur_sym != srcSize) {
+        ans_frame.encode_mapped(states[0],
+            ans_msb_mapping(in_u32[srcSize - cur_sym - 1]), out_u8);
+        ans_frame.encode_mapped(states[1],
+            ans_msb_mapping(in_u32[srcSize - cur_sym - 2]), out_u8);
+        ans_frame.encode_mapped(states[2],
+            ans_msb_mapping(in_u32[srcSize - cur_sym - 3]), out_u8);
+        ans_frame.encode_mapped(states[3],
+            ans_msb_mapping(in_u32[srcSize - cur_sym - 4]), out_u8);
+        cur_sym += num_states;
+    }
+
+    // flush final state
+    for (uint32_t i = 0; i < num_states; i++)
+        ans_frame.flush_state(states[i], out_u8);
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+// the decode state of ans_msb_decode, copied so it can live in registers
+// while the exception cursors are updated through memory
+struct ans_msb_ex_frame {
+    const dec_entry_msb* table;
+    uint64_t frame_mask;
+    uint64_t frame_log2;
+    uint64_t lower_bound;
+    const uint8_t** const* cursors;
+
+    // same as ans_msb_decode::decode_sym but the exception bytes are read
+    // through the cursor of the (bucket, byte position) slot
+    uint32_t decode_sym(uint64_t& state, const uint8_t*& in_u8) const
+    {
+        const auto& entry = table[state & frame_mask];
+        state = uint64_t(entry.freq) * (state >> frame_log2)
+            + uint64_t(entry.offset);
+        if (state < lower_bound) {
+            in_u8 -= sizeof(uint32_t);
+            auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
+            state = state << constants::RADIX_LOG2 | uint64_t(*in_ptr_u32);
+        }
+        uint32_t except_bytes = entry.mapped_num >> 30;
+        uint32_t value = entry.mapped_num & 0x3FFFFFFF;
+        if (except_bytes != 0) {
+            uint32_t sym = (value >> (8 * except_bytes)) + (except_bytes << 8);
+            auto slot = cursors + sym * msb_ex_constants::MAX_EXCEPT;
+            for (uint32_t j = 0; j < except_bytes; j++) {
+                value += uint32_t(*(*slot[j])++) << (8 * j);
+            }
+        }
+        return value;
+    }
+};
+
+void ans_msb_ex_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    const uint32_t num_states = 4;
+    const uint32_t MAX_EXCEPT = msb_ex_constants::MAX_EXCEPT;
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    if (*in_u8++ == 0) {
+        ans_msb_decompress(dst, to_decode, in_u8, cSrcSize - 1);
+        return;
+    }
+
+    // (1) expand the exception streams
+    std::vector<uint32_t> slot_stream(msb_ex_constants::NUM_SLOTS);
+    for (uint32_t slot = 0; slot < msb_ex_constants::NUM_SLOTS; slot++)
+        slot_stream[slot] = slot % MAX_EXCEPT;
+    uint32_t num_own = vbyte_decode_u32(in_u8);
+    for (uint32_t k = 0; k < num_own; k++)
+        slot_stream[vbyte_decode_u32(in_u8)] = MAX_EXCEPT + k;
+    size_t num_streams = MAX_EXCEPT + num_own;
+    std::vector<uint32_t> raw_bytes(num_streams);
+    std::vector<uint32_t> stored_bytes(num_streams);
+    size_t total_bytes = 0;
+    for (size_t s = 0; s < num_streams; s++) {
+        raw_bytes[s] = vbyte_decode_u32(in_u8);
+        stored_bytes[s] = vbyte_decode_u32(in_u8);
+        total_bytes += raw_bytes[s];
+    }
+    std::vector<uint8_t> except(total_bytes);
+    std::vector<const uint8_t*> stream_cursor(num_streams);
+    size_t offset = 0;
+    for (size_t s = 0; s < num_streams; s++) {
+        stream_cursor[s] = except.data() + offset;
+        if (stored_bytes[s] < raw_bytes[s]) {
+            ans_byte_decompress(except.data() + offset, raw_bytes[s], in_u8,
+                stored_bytes[s]);
+        } else {
+            memcpy(except.data() + offset, in_u8, raw_bytes[s]);
+        }
+        in_u8 += stored_bytes[s];
+        offset += raw_bytes[s];
+    }
+    std::vector<const uint8_t**> cursors(msb_ex_constants::NUM_SLOTS);
+    for (uint32_t slot = 0; slot < msb_ex_constants::NUM_SLOTS; slot++)
+        cursors[slot] = &stream_cursor[slot_stream[slot]];
+
+    // (2) decode the buckets
+    auto model = ans_msb_decode::load(in_u8);
+    const ans_msb_ex_frame ans_frame { model.table.data(), model.frame_mask,
+        model.frame_log2, model.lower_bound, cursors.data() };
+    in_u8 = cSrc + cSrcSize;
+
+    std::array<uint64_t, num_states> states;
+    for (uint32_t i = 0; i < num_states; i++) {
+        states[i] = model.init_state(in_u8);
+    }
+
+    size_t cur_idx = 0;
+    auto out_u32 = reinterpret_cast<uint32_t*>(dst);
+    size_t fast_decode = to_decode - (to_decode % num_states);
+    while (cur_idx != fast_decode) {
+        out_u32[cur_idx] = ans_frame.decode_sym(states[0], in_u8);
+        out_u32[cur_idx + 1] = ans_frame.decode_sym(states[1], in_u8);
+        out_u32[cur_idx + 2] = ans_frame.decode_sym(states[2], in_u8);
+        out_u32[cur_idx + 3] = ans_frame.decode_sym(states[3], in_u8);
+        cur_idx += num_states;
+    }
+    while (cur_idx != to_decode) {
+        out_u32[cur_idx++]
+            = ans_frame.decode_sym(states[num_states - 1], in_u8);
+    }
+}
@@ -0,0 +1,399 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* Order-1 version of ans_msb.hpp.
+
+   The model used for a symbol is selected by the msb bucket of the previous
+   symbol. The most frequent previous buckets get a model of their own, all
+   remaining buckets are merged into one shared context, so at most
+   max_contexts models are stored. Each context has its own frame size
+   (chosen by adjust_freqs) and all of them share the lower bound of the
+   largest frame, which keeps the 4 interleaved states interchangeable
+   between contexts. The context of the next symbol is stored in every
+   decode table entry, so the decoder never maps a decoded value back to
+   its bucket.
+
+   The frequencies of every context are coded independently of the other
+   contexts, but all of them go into a single interpolative list, so there
+   is no per-context frame size, length prefix or word padding.
+*/
+
+#include "ans_msb.hpp"
+
+namespace msb_o1_constants {
+const uint32_t MIN_CONTEXT_SYMS = 4096;
+}
+
+struct enc_context_msb_o1 {
+    std::vector<uint32_t> nfreqs;
+    std::vector<enc_entry_msb> table;
+    uint64_t frame_size;
+};
+
+struct ans_msb_o1_encode {
+    static ans_msb_o1_encode create(
+        const uint32_t* in_u32, size_t n, uint32_t max_contexts)
+    {
+        ans_msb_o1_encode model;
+
+        // pick the contexts. the first symbol uses bucket 0 as context
+        std::vector<uint64_t> prev_freqs(msb_constants::MAX_SIGMA, 0);
+        prev_freqs[0]++;
+        for (size_t i = 1; i < n; i++) {
+            prev_freqs[ans_msb_mapping(in_u32[i - 1])]++;
+        }
+        uint32_t num_contexts = model.select_buckets(prev_freqs, max_contexts);
+        model.build_contexts(in_u32, n, num_contexts,
+            [&](size_t i) { return model.context(in_u32, i); });
+        return model;
+    }
+
+    // the most frequent buckets get contexts first_ctx, first_ctx + 1, ...
+    // and the remaining ones share the context after them. returns the
+    // total number of contexts
+    uint32_t select_buckets(const std::vector<uint64_t>& bucket_freqs,
+        uint32_t max_contexts, uint32_t first_ctx = 0)
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> sorted_prev;
+        for (uint32_t sym = 0; sym < bucket_freqs.size(); sym++) {
+            if (bucket_freqs[sym] != 0)
+                sorted_prev.emplace_back(bucket_freqs[sym], sym);
+        }
+        std::sort(sorted_prev.begin(), sorted_prev.end(),
+            std::greater<std::pair<uint64_t, uint32_t>>());
+        uint64_t merged_syms = 0;
+        for (size_t i = 0; i < sorted_prev.size(); i++) {
+            if (buckets.size() + 1 < max_contexts
+                && sorted_prev[i].first >= msb_o1_constants::MIN_CONTEXT_SYMS)
+                buckets.push_back(sorted_prev[i].second);
+            else
+                merged_syms += sorted_prev[i].first;
+        }
+        uint32_t num_contexts = first_ctx + buckets.size() + (merged_syms != 0);
+        ctx_of_bucket.assign(msb_constants::MAX_SIGMA,
+            std::min<uint32_t>(first_ctx + buckets.size(), num_contexts - 1));
+        for (uint32_t c = 0; c < buckets.size(); c++) {
+            ctx_of_bucket[buckets[c]] = first_ctx + c;
+        }
+        return num_contexts;
+    }
+
+    // one distribution per context, context(i) gives the context of in_u32[i]
+    template <class t_context>
+    void build_contexts(const uint32_t* in_u32, size_t n,
+        uint32_t num_contexts, t_context context)
+    {
+        std::vector<std::vector<uint64_t>> freqs(num_contexts,
+            std::vector<uint64_t>(msb_constants::MAX_SIGMA, 0));
+        std::vector<uint32_t> max_sym(num_contexts, 0);
+        for (size_t i = 0; i < n; i++) {
+            auto ctx = context(i);
+            auto mapped_u32 = ans_msb_mapping(in_u32[i]);
+            freqs[ctx][mapped_u32]++;
+            max_sym[ctx] = std::max(mapped_u32, max_sym[ctx]);
+        }
+        contexts.resize(num_contexts);
+        uint64_t max_frame_size = 1;
+        for (uint32_t c = 0; c < num_contexts; c++) {
+            auto& ctx = contexts[c];
+            ctx.nfreqs = adjust_freqs(freqs[c], max_sym[c], true);
+            ctx.frame_size = std::accumulate(
+                std::begin(ctx.nfreqs), std::end(ctx.nfreqs), 0);
+            max_frame_size = std::max(max_frame_size, ctx.frame_size);
+        }
+        lower_bound = constants::K * max_frame_size;
+        for (auto& ctx : contexts) {
+            // empty input leaves a context without symbols
+            uint64_t k = lower_bound / std::max<uint64_t>(ctx.frame_size, 1);
+            uint64_t tmp = k * constants::RADIX;
+            uint64_t cur_base = 0;
+            ctx.table.resize(ctx.nfreqs.size());
+            for (size_t sym = 0; sym < ctx.nfreqs.size(); sym++) {
+                ctx.table[sym].freq = ctx.nfreqs[sym];
+                ctx.table[sym].base = cur_base;
+                ctx.table[sym].sym_upper_bound = tmp * ctx.nfreqs[sym];
+                cur_base += ctx.nfreqs[sym];
+            }
+        }
+    }
+
+    uint32_t context(const uint32_t* in_u32, size_t i) const
+    {
+        if (i == 0)
+            return ctx_of_bucket[0];
+        return ctx_of_bucket[ans_msb_mapping(in_u32[i - 1])];
+    }
+
+    // context buckets, then the frequencies of all contexts (see
+    // ans_msb_o1_load_freqs)
+    size_t serialize(uint8_t*& out_u8)
+    {
+        auto start = out_u8;
+        vbyte_encode_u32(out_u8, contexts.size());
+        vbyte_encode_u32(out_u8, buckets.size());
+        for (auto bucket : buckets) {
+            vbyte_encode_u32(out_u8, bucket);
+        }
+        // each context covers the symbols up to its largest one and
+        // continues the increasing list where the one before it ended,
+        // every frequency adds its value plus one
+        std::vector<uint32_t> list;
+        uint32_t end = 0;
+        for (const auto& ctx : contexts) {
+            size_t ctx_size = ctx.nfreqs.size();
+            while (ctx_size != 0 && ctx.nfreqs[ctx_size - 1] == 0)
+                ctx_size--;
+            vbyte_encode_u32(out_u8, ctx_size);
+            for (size_t sym = 0; sym < ctx_size; sym++) {
+                end += ctx.nfreqs[sym] + 1;
+                list.push_back(end - 1);
+            }
+        }
+        vbyte_encode_u32(out_u8, end);
+        auto out_ptr_u32 = reinterpret_cast<uint32_t*>(out_u8);
+        out_u8 += interpolative_internal::encode(
+            out_ptr_u32, list.data(), list.size(), end + 1);
+        return out_u8 - start;
+    }
+
+    void encode_symbol(
+        uint64_t& state, uint32_t sym, uint32_t c, uint8_t*& out_u8)
+    {
+        const auto& ctx = contexts[c];
+        auto mapped_sym = ans_msb_mapping_and_exceptions(sym, out_u8);
+        const auto& e = ctx.table[mapped_sym];
+        if (state >= e.sym_upper_bound) {
+            auto out_ptr_u32 = reinterpret_cast<uint32_t*>(out_u8);
+            *out_ptr_u32 = state & 0xFFFFFFFF;
+            out_u8 += sizeof(uint32_t);
+            state = state >> constants::RADIX_LOG2;
+        }
+        state = ((state / e.freq) * ctx.frame_size) + (state % e.freq)
+            + e.base;
+    }
+    uint64_t initial_state() const { return lower_bound; }
+
+    void flush_state(uint64_t state, uint8_t*& out_u8)
+    {
+        auto out_ptr_u64 = reinterpret_cast<uint64_t*>(out_u8);
+        *out_ptr_u64++ = state - lower_bound;
+        out_u8 += sizeof(uint64_t);
+    }
+
+    std::vector<uint32_t> buckets;
+    std::vector<uint32_t> ctx_of_bucket;
+    std::vector<enc_context_msb_o1> contexts;
+    uint64_t lower_bound;
+};
+
+// next_ctx holds the table offset of the next context shifted left by 5
+// and the log2 of its frame size in the low 5 bits, so the decoder goes
+// straight from one entry to the next without another lookup
+#pragma pack(push, 1)
+struct dec_entry_msb_o1 {
+    dec_entry_msb entry;
+    uint32_t next_ctx;
+};
+#pragma pack(pop)
+
+// the frequencies of the num_contexts contexts written by
+// ans_msb_o1_encode::serialize: the vbyte number of symbols of every
+// context and the end of the list, then the interp coded running sums of
+// the frequencies plus one of all contexts, one after the other
+std::vector<std::vector<uint32_t>> ans_msb_o1_load_freqs(
+    const uint8_t* in_u8, uint32_t num_contexts)
+{
+    std::vector<std::vector<uint32_t>> nfreqs(num_contexts);
+    size_t list_size = 0;
+    for (uint32_t c = 0; c < num_contexts; c++) {
+        nfreqs[c].resize(vbyte_decode_u32(in_u8));
+        list_size += nfreqs[c].size();
+    }
+    uint32_t end = vbyte_decode_u32(in_u8);
+    std::vector<uint32_t> list(list_size);
+    auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
+    interpolative_internal::decode(
+        in_ptr_u32, list.data(), list.size(), end + 1);
+    uint32_t prev = -1;
+    auto sums = list.data();
+    for (auto& ctx_freqs : nfreqs) {
+        for (size_t sym = 0; sym < ctx_freqs.size(); sym++) {
+            ctx_freqs[sym] = sums[sym] - prev - 1;
+            prev = sums[sym];
+        }
+        sums += ctx_freqs.size();
+    }
+    return nfreqs;
+}
+
+struct ans_msb_o1_decode {
+    static ans_msb_o1_decode load(const uint8_t* in_u8)
+    {
+        ans_msb_o1_decode model;
+        uint32_t num_contexts = vbyte_decode_u32(in_u8);
+        uint32_t num_buckets = vbyte_decode_u32(in_u8);
+        std::vector<uint32_t> ctx_of_bucket(
+            msb_constants::MAX_SIGMA, std::min(num_buckets, num_contexts - 1));
+        for (uint32_t c = 0; c < num_buckets; c++) {
+            ctx_of_bucket[vbyte_decode_u32(in_u8)] = c;
+        }
+
+        auto nfreqs = ans_msb_o1_load_freqs(in_u8, num_contexts);
+        std::vector<uint32_t> packed(num_contexts);
+        std::vector<uint64_t> starts(num_contexts);
+        uint64_t max_frame_size = 1;
+        uint64_t total_size = 0;
+        for (uint32_t c = 0; c < num_contexts; c++) {
+            uint64_t frame_size = std::accumulate(
+                std::begin(nfreqs[c]), std::end(nfreqs[c]), 0);
+            starts[c] = total_size;
+            // empty input leaves a context without symbols
+            packed[c] = (total_size << 5)
+                | uint32_t(log2(std::max<uint64_t>(frame_size, 1)));
+            max_frame_size = std::max(max_frame_size, frame_size);
+            total_size += frame_size;
+        }
+        model.start_ctx = packed[ctx_of_bucket[0]];
+
+        model.table.resize(total_size);
+        for (uint32_t c = 0; c < num_contexts; c++) {
+            auto table = model.table.data() + starts[c];
+            uint32_t cur_base = 0;
+            for (size_t sym = 0; sym < nfreqs[c].size(); sym++) {
+                auto cur_freq = nfreqs[c][sym];
+                uint32_t except_bytes = ans_msb_exception_bytes(sym);
+                for (uint32_t k = 0; k < cur_freq; k++) {
+                    table[cur_base + k].entry.freq = cur_freq;
+                    table[cur_base + k].entry.mapped_num
+                        = ans_msb_undo_mapping(sym) + (except_bytes << 30);
+                    table[cur_base + k].entry.offset = k;
+                    table[cur_base + k].next_ctx
+                        = packed[ctx_of_bucket[sym]];
+                }
+                cur_base += cur_freq;
+            }
+        }
+        model.lower_bound = constants::K * max_frame_size;
+        return model;
+    }
+
+    uint64_t init_state(const uint8_t*& in_u8)
+    {
+        in_u8 -= sizeof(uint64_t);
+        auto in_ptr_u64 = reinterpret_cast<const uint64_t*>(in_u8);
+        return *in_ptr_u64 + lower_bound;
+    }
+
+    uint32_t decode_sym(uint64_t& state, uint32_t& c, const uint8_t*& in_u8)
+    {
+        uint32_t frame_log2 = c & 31;
+        uint64_t frame_mask = (1ULL << frame_log2) - 1;
+        const auto& e = table[(c >> 5) + (state & frame_mask)];
+        state = uint64_t(e.entry.freq) * (state >> frame_log2)
+            + uint64_t(e.entry.offset);
+        // the context chain serializes the states, so keep the input pointer
+        // update branch free. the word before the stream is in the prelude
+        auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8) - 1;
+        uint64_t renorm = state < lower_bound;
+        uint64_t refill
+            = state << constants::RADIX_LOG2 | uint64_t(*in_ptr_u32);
+        state = renorm ? refill : state;
+        in_u8 -= renorm * sizeof(uint32_t);
+        c = e.next_ctx;
+        auto decoded_sym = ans_msb_undo_mapping(e.entry, in_u8);
+        return decoded_sym;
+    }
+
+    table_vector<dec_entry_msb_o1> table;
+    uint64_t lower_bound;
+    uint32_t start_ctx;
+};
+
+template <uint32_t max_contexts>
+size_t ans_msb_o1_compress(
+    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+{
+    static_assert(max_contexts >= 1, "need at least one context");
+    const uint32_t num_states = 4;
+    auto in_u32 = reinterpret_cast<const uint32_t*>(src);
+    auto ans_frame = ans_msb_o1_encode::create(in_u32, srcSize, max_contexts);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+
+    // serialize model
+    ans_frame.serialize(out_u8);
+
+    std::array<uint64_t, num_states> states;
+
+    // start encoding
+    for (uint32_t i = 0; i < num_states; i++)
+        states[i] = ans_frame.initial_state();
+
+    size_t cur_sym = 0;
+    while ((srcSize - cur_sym) % num_states != 0) {
+        size_t i = srcSize - cur_sym - 1;
+        ans_frame.encode_symbol(
+            states[0], in_u32[i], ans_frame.context(in_u32, i), out_u8);
+        cur_sym += 1;
+    }
+    while (cur_sym != srcSize) {
+        for (uint32_t j = 0; j < num_states; j++) {
+            size_t i = srcSize - cur_sym - 1 - j;
+            ans_frame.encode_symbol(
+                states[j], in_u32[i], ans_frame.context(in_u32, i), out_u8);
+        }
+        cur_sym += num_states;
+    }
+
+    // flush final state
+    for (uint32_t i = 0; i < num_states; i++)
+        ans_frame.flush_state(states[i], out_u8);
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+void ans_msb_o1_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    const uint32_t num_states = 4;
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    auto ans_frame = ans_msb_o1_decode::load(in_u8);
+    in_u8 += cSrcSize;
+
+    std::array<uint64_t, num_states> states;
+
+    for (uint32_t i = 0; i < num_states; i++) {
+        states[i] = ans_frame.init_state(in_u8);
+    }
+
+    uint32_t ctx = ans_frame.start_ctx;
+    size_t cur_idx = 0;
+    auto out_u32 = reinterpret_cast<uint32_t*>(dst);
+    size_t fast_decode = to_decode - (to_decode % num_states);
+    while (cur_idx != fast_decode) {
+        out_u32[cur_idx] = ans_frame.decode_sym(states[0], ctx, in_u8);
+        out_u32[cur_idx + 1] = ans_frame.decode_sym(states[1], ctx, in_u8);
+        out_u32[cur_idx + 2] = ans_frame.decode_sym(states[2], ctx, in_u8);
+        out_u32[cur_idx + 3] = ans_frame.decode_sym(states[3], ctx, in_u8);
+        cur_idx += num_states;
+    }
+    while (cur_idx != to_decode) {
+        out_u32[cur_idx++]
+            = ans_frame.decode_sym(states[num_states - 1], ctx, in_u8);
+    }
+}
@@ -0,0 +1,377 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* ans_msb with an alphabet extended by frequent runs of small symbols.
+
+   One counting pass over the input collects the frequencies of adjacent
+   pairs of values below 256 and of triples of values below 16. The most
+   useful ones (up to 256) become the extra symbols 1024 to 1279, which the
+   msb mapping leaves unused. The input is then parsed greedily into
+   tokens, longest match first, and the tokens are coded exactly like
+   ans_msb symbols, with the exception bytes of single values in the same
+   stream. A decode table entry stores all values of its token, so one
+   decode step emits up to three integers.
+*/
+
+#include "ans_msb.hpp"
+
+namespace msb_pair_constants {
+const uint32_t EXT_START = 1024;
+const uint32_t MAX_EXT = msb_constants::MAX_SIGMA - EXT_START;
+const uint32_t PAIR_LIMIT = 256;
+const uint32_t TRIPLE_LIMIT = 16;
+const uint32_t MIN_EXT_FREQ = 64;
+}
+
+struct ans_msb_pair_encode {
+    static ans_msb_pair_encode create(const uint32_t* in_u32, size_t n)
+    {
+        ans_msb_pair_encode model;
+        model.select_extensions(in_u32, n);
+        model.tokenize(in_u32, n);
+
+        std::vector<uint64_t> freqs(msb_constants::MAX_SIGMA, 0);
+        uint32_t max_sym = 0;
+        for (auto sym : model.syms) {
+            freqs[sym]++;
+            max_sym = std::max(sym, max_sym);
+        }
+        model.nfreqs = adjust_freqs(freqs, max_sym, true);
+        model.frame_size = std::accumulate(
+            std::begin(model.nfreqs), std::end(model.nfreqs), 0);
+        uint64_t cur_base = 0;
+        uint64_t tmp = constants::K * constants::RADIX;
+        model.table.resize(max_sym + 1);
+        for (size_t sym = 0; sym < model.nfreqs.size(); sym++) {
+            model.table[sym].freq = model.nfreqs[sym];
+            model.table[sym].base = cur_base;
+            model.table[sym].sym_upper_bound = tmp * model.nfreqs[sym];
+            cur_base += model.nfreqs[sym];
+        }
+        model.lower_bound = constants::K * model.frame_size;
+        return model;
+    }
+
+    // single counting pass over pairs and triples of small values. a
+    // candidate scores the number of decode steps it saves
+    void select_extensions(const uint32_t* in_u32, size_t n)
+    {
+        const uint32_t P = msb_pair_constants::PAIR_LIMIT;
+        const uint32_t T = msb_pair_constants::TRIPLE_LIMIT;
+        std::vector<uint32_t> pair_freqs(P * P, 0);
+        std::vector<uint32_t> triple_freqs(T * T * T, 0);
+        for (size_t i = 0; i + 1 < n; i++) {
+            uint32_t a = in_u32[i], b = in_u32[i + 1];
+            if (a < P && b < P) {
+                pair_freqs[a * P + b]++;
+                if (i + 2 < n) {
+                    uint32_t c = in_u32[i + 2];
+                    if (a < T && b < T && c < T)
+                        triple_freqs[(a * T + b) * T + c]++;
+                }
+            }
+        }
+
+        std::vector<std::pair<uint64_t, uint32_t>> candidates;
+        for (uint32_t k = 0; k < P * P; k++) {
+            if (pair_freqs[k] >= msb_pair_constants::MIN_EXT_FREQ)
+                candidates.emplace_back(pair_freqs[k], k);
+        }
+        for (uint32_t k = 0; k < T * T * T; k++) {
+            if (triple_freqs[k] >= msb_pair_constants::MIN_EXT_FREQ)
+                candidates.emplace_back(2 * triple_freqs[k], P * P + k);
+        }
+        std::sort(candidates.begin(), candidates.end(),
+            std::greater<std::pair<uint64_t, uint32_t>>());
+        if (candidates.size() > msb_pair_constants::MAX_EXT)
+            candidates.resize(msb_pair_constants::MAX_EXT);
+
+        pair_ids.assign(P * P, 0);
+        triple_ids.assign(T * T * T, 0);
+        for (const auto& c : candidates) {
+            uint32_t sym = msb_pair_constants::EXT_START + exts.size();
+            if (c.second < P * P) {
+                pair_ids[c.second] = sym;
+                exts.push_back({ c.second / P, c.second % P });
+            } else {
+                uint32_t k = c.second - P * P;
+                triple_ids[k] = sym;
+                exts.push_back({ k / (T * T), (k / T) % T, k % T });
+            }
+        }
+    }
+
+    // greedy longest match parse into ans_msb symbols and extensions
+    void tokenize(const uint32_t* in_u32, size_t n)
+    {
+        const uint32_t P = msb_pair_constants::PAIR_LIMIT;
+        const uint32_t T = msb_pair_constants::TRIPLE_LIMIT;
+        syms.reserve(n);
+        vals.reserve(n);
+        size_t i = 0;
+        while (i < n) {
+            uint32_t a = in_u32[i];
+            if (i + 2 < n && a < T && in_u32[i + 1] < T && in_u32[i + 2] < T) {
+                uint32_t k = (a * T + in_u32[i + 1]) * T + in_u32[i + 2];
+                if (triple_ids[k] != 0) {
+                    syms.push_back(triple_ids[k]);
+                    vals.push_back(0);
+                    i += 3;
+                    continue;
+                }
+            }
+            if (i + 1 < n && a < P && in_u32[i + 1] < P) {
+                uint32_t k = a * P + in_u32[i + 1];
+                if (pair_ids[k] != 0) {
+                    syms.push_back(pair_ids[k]);
+                    vals.push_back(0);
+                    i += 2;
+                    continue;
+                }
+            }
+            syms.push_back(ans_msb_mapping(a));
+            vals.push_back(a);
+            i += 1;
+        }
+    }
+
+    // token count and extensions, then the ans_msb prelude
+    size_t serialize(uint8_t*& out_u8)
+    {
+        auto start = out_u8;
+        vbyte_encode_u32(out_u8, syms.size());
+        vbyte_encode_u32(out_u8, exts.size());
+        for (const auto& ext : exts) {
+            *out_u8++ = ext.size();
+            for (auto v : ext)
+                *out_u8++ = v;
+        }
+        ans_serialize_interp(nfreqs, frame_size, out_u8);
+        return out_u8 - start;
+    }
+
+    void encode_token(uint64_t& state, size_t tok, uint8_t*& out_u8)
+    {
+        uint32_t mapped_sym = syms[tok];
+        if (mapped_sym < msb_pair_constants::EXT_START)
+            ans_msb_mapping_and_exceptions(vals[tok], out_u8);
+        const auto& e = table[mapped_sym];
+        if (state >= e.sym_upper_bound) {
+            auto out_ptr_u32 = reinterpret_cast<uint32_t*>(out_u8);
+            *out_ptr_u32 = state & 0xFFFFFFFF;
+            out_u8 += sizeof(uint32_t);
+            state = state >> constants::RADIX_LOG2;
+        }
+        state = ((state / e.freq) * frame_size) + (state % e.freq) + e.base;
+    }
+    uint64_t initial_state() const { return lower_bound; }
+
+    void flush_state(uint64_t state, uint8_t*& out_u8)
+    {
+        auto out_ptr_u64 = reinterpret_cast<uint64_t*>(out_u8);
+        *out_ptr_u64++ = state - lower_bound;
+        out_u8 += sizeof(uint64_t);
+    }
+
+    std::vector<uint32_t> pair_ids;
+    std::vector<uint32_t> triple_ids;
+    std::vector<std::vector<uint32_t>> exts;
+    std::vector<uint32_t> syms;
+    std::vector<uint32_t> vals;
+    std::vector<uint32_t> nfreqs;
+    std::vector<enc_entry_msb> table;
+    uint64_t frame_size;
+    uint64_t lower_bound;
+};
+
+// rest holds the second and third value of an extension in its low two
+// bytes and the number of values beyond the first in bits 16 and up
+#pragma pack(push, 1)
+struct dec_entry_msb_pair {
+    dec_entry_msb entry;
+    uint32_t rest;
+};
+#pragma pack(pop)
+
+struct ans_msb_pair_decode {
+    static ans_msb_pair_decode load(const uint8_t* in_u8)
+    {
+        ans_msb_pair_decode model;
+        model.num_tokens = vbyte_decode_u32(in_u8);
+        uint32_t num_exts = vbyte_decode_u32(in_u8);
+        std::vector<std::vector<uint32_t>> exts(num_exts);
+        for (auto& ext : exts) {
+            uint32_t len = *in_u8++;
+            for (uint32_t k = 0; k < len; k++)
+                ext.push_back(*in_u8++);
+        }
+        model.nfreqs = ans_load_interp(in_u8);
+        model.frame_size = std::accumulate(
+            std::begin(model.nfreqs), std::end(model.nfreqs), 0);
+        model.frame_mask = model.frame_size - 1;
+        model.frame_log2 = log2(model.frame_size);
+        model.table.resize(model.frame_size);
+        auto max_sym = model.nfreqs.size() - 1;
+        uint32_t cur_base = 0;
+        for (size_t sym = 0; sym <= max_sym; sym++) {
+            auto cur_freq = model.nfreqs[sym];
+            uint32_t mapped_num, rest = 0;
+            if (sym < msb_pair_constants::EXT_START) {
+                uint32_t except_bytes = ans_msb_exception_bytes(sym);
+                mapped_num = ans_msb_undo_mapping(sym) + (except_bytes << 30);
+            } else {
+                const auto& ext = exts[sym - msb_pair_constants::EXT_START];
+                mapped_num = ext[0];
+                for (size_t k = 1; k < ext.size(); k++)
+                    rest |= ext[k] << (8 * (k - 1));
+                rest |= (ext.size() - 1) << 16;
+            }
+            for (uint32_t k = 0; k < cur_freq; k++) {
+                model.table[cur_base + k].entry.freq = cur_freq;
+                model.table[cur_base + k].entry.mapped_num = mapped_num;
+                model.table[cur_base + k].entry.offset = k;
+                model.table[cur_base + k].rest = rest;
+            }
+            cur_base += model.nfreqs[sym];
+        }
+        model.lower_bound = constants::K * model.frame_size;
+        return model;
+    }
+
+    uint64_t init_state(const uint8_t*& in_u8)
+    {
+        in_u8 -= sizeof(uint64_t);
+        auto in_ptr_u64 = reinterpret_cast<const uint64_t*>(in_u8);
+        return *in_ptr_u64 + lower_bound;
+    }
+
+    const dec_entry_msb_pair& decode_token(
+        uint64_t& state, const uint8_t*& in_u8)
+    {
+        const auto& e = table[state & frame_mask];
+        state = uint64_t(e.entry.freq) * (state >> frame_log2)
+            + uint64_t(e.entry.offset);
+        if (state < lower_bound) {
+            in_u8 -= sizeof(uint32_t);
+            auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
+            state = state << constants::RADIX_LOG2 | uint64_t(*in_ptr_u32);
+        }
+        return e;
+    }
+
+    // always writes three values, only valid with room in the output
+    void decode_sym(uint64_t& state, uint32_t*& out_u32, const uint8_t*& in_u8)
+    {
+        const auto& e = decode_token(state, in_u8);
+        out_u32[0] = ans_msb_undo_mapping(e.entry, in_u8);
+        out_u32[1] = e.rest & 0xFF;
+        out_u32[2] = (e.rest >> 8) & 0xFF;
+        out_u32 += 1 + (e.rest >> 16);
+    }
+
+    void decode_sym_tail(
+        uint64_t& state, uint32_t*& out_u32, const uint8_t*& in_u8)
+    {
+        const auto& e = decode_token(state, in_u8);
+        *out_u32++ = ans_msb_undo_mapping(e.entry, in_u8);
+        for (uint32_t k = 0; k < (e.rest >> 16); k++)
+            *out_u32++ = (e.rest >> (8 * k)) & 0xFF;
+    }
+
+    std::vector<uint32_t> nfreqs;
+    uint64_t num_tokens;
+    uint64_t frame_size;
+    uint64_t frame_mask;
+    uint64_t frame_log2;
+    uint64_t lower_bound;
+    table_vector<dec_entry_msb_pair> table;
+};
+
+size_t ans_msb_pair_compress(
+    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+{
+    const uint32_t num_states = 4;
+    auto in_u32 = reinterpret_cast<const uint32_t*>(src);
+    auto ans_frame = ans_msb_pair_encode::create(in_u32, srcSize);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+
+    // serialize model
+    ans_frame.serialize(out_u8);
+
+    std::array<uint64_t, num_states> states;
+
+    // start encoding
+    for (uint32_t i = 0; i < num_states; i++)
+        states[i] = ans_frame.initial_state();
+
+    size_t num_tokens = ans_frame.syms.size();
+    size_t cur_tok = 0;
+    while ((num_tokens - cur_tok) % num_states != 0) {
+        ans_frame.encode_token(states[0], num_tokens - cur_tok - 1, out_u8);
+        cur_tok += 1;
+    }
+    while (cur_tok != num_tokens) {
+        ans_frame.encode_token(states[0], num_tokens - cur_tok - 1, out_u8);
+        ans_frame.encode_token(states[1], num_tokens - cur_tok - 2, out_u8);
+        ans_frame.encode_token(states[2], num_tokens - cur_tok - 3, out_u8);
+        ans_frame.encode_token(states[3], num_tokens - cur_tok - 4, out_u8);
+        cur_tok += num_states;
+    }
+
+    // flush final state
+    for (uint32_t i = 0; i < num_states; i++)
+        ans_frame.flush_state(states[i], out_u8);
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+void ans_msb_pair_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    const uint32_t num_states = 4;
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    auto ans_frame = ans_msb_pair_decode::load(in_u8);
+    in_u8 += cSrcSize;
+
+    std::array<uint64_t, num_states> states;
+
+    for (uint32_t i = 0; i < num_states; i++) {
+        states[i] = ans_frame.init_state(in_u8);
+    }
+
+    // four tokens write at most twelve values
+    size_t num_tokens = ans_frame.num_tokens;
+    size_t fast_tokens = num_tokens - (num_tokens % num_states);
+    size_t cur_tok = 0;
+    auto out_u32 = reinterpret_cast<uint32_t*>(dst);
+    auto out_end = out_u32 + to_decode;
+    while (cur_tok != fast_tokens && out_end - out_u32 >= 12) {
+        ans_frame.decode_sym(states[0], out_u32, in_u8);
+        ans_frame.decode_sym(states[1], out_u32, in_u8);
+        ans_frame.decode_sym(states[2], out_u32, in_u8);
+        ans_frame.decode_sym(states[3], out_u32, in_u8);
+        cur_tok += num_states;
+    }
+    while (cur_tok != num_tokens) {
+        auto& state = cur_tok < fast_tokens ? states[cur_tok % num_states]
+                                            : states[num_states - 1];
+        ans_frame.decode_sym_tail(state, out_u32, in_u8);
+        cur_tok++;
+    }
+}
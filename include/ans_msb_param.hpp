@@ -0,0 +1,504 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* ans_msb with a parametric prelude.
+
+   Instead of the interpolative coded frequencies the prelude can describe
+   a geometric or a zipf distribution over the input values by a 16 bit
+   parameter. Both sides integrate the distribution over the value range
+   of every msb bucket and scale the result to the frame size, so the
+   decoder builds the normalized frequencies without reading them. The
+   integrals are evaluated in fixed point, with integer log2 and exp2, so
+   the frequencies of both sides are bit identical whatever the libm or
+   floating point contraction of either build. A short
+   list of corrections pins the frequency of the buckets the distribution
+   fits worst. The encoder fits both families and picks the one, or the
+   regular interp prelude, with the smallest prelude plus payload size.
+
+   Layout: family byte, then either the ans_msb prelude (INTERP) or vbyte
+   max_sym, frame log2 byte, vbyte parameter, vbyte number of corrections
+   and the (vbyte sym gap, vbyte freq) of every correction. The ans_msb
+   stream follows (read backwards as in ans_msb).
+*/
+
+#include "ans_msb.hpp"
+
+namespace param_constants {
+const uint8_t INTERP = 0;
+const uint8_t GEOMETRIC = 1;
+const uint8_t ZIPF = 2;
+const uint32_t MAX_CODE = (1 << 16) - 1;
+const uint32_t MAX_CORRECTIONS = 32;
+}
+
+namespace param_fixed {
+// log2 values in fixed point with FRAC_BITS fraction bits, probabilities
+// in [0, 1] as Q62
+const uint32_t FRAC_BITS = 32;
+const int64_t ONE = int64_t(1) << FRAC_BITS;
+const uint32_t PROB_BITS = 62;
+const uint64_t PROB_ONE = uint64_t(1) << PROB_BITS;
+// ln(2) as Q62 and log2(log2(e)) with FRAC_BITS fraction bits
+const uint64_t LN2 = 3196577161300663915ULL;
+const int64_t LOG2_LOG2E = 2271034279;
+// log2 scales are clamped to -MAX_LOG2, far below any used probability
+const int64_t MAX_LOG2 = ONE << 24;
+// 1 / i! as Q62, the terms of e^z for 0 <= z <= ln(2) up to 2^-62
+const uint64_t INV_FACTORIAL[] = { 4611686018427387904ULL,
+    4611686018427387904ULL, 2305843009213693952ULL, 768614336404564650ULL,
+    192153584101141162ULL, 38430716820228232ULL, 6405119470038038ULL,
+    915017067148291ULL, 114377133393536ULL, 12708570377059ULL,
+    1270857037705ULL, 115532457973ULL, 9627704831ULL, 740592679ULL,
+    52899477ULL, 3526631ULL, 220414ULL, 12965ULL, 720ULL };
+}
+
+// log2(x) for x >= 1, the fraction bit by bit by squaring the mantissa
+int64_t ans_param_log2(uint64_t x)
+{
+    using namespace param_fixed;
+    uint32_t int_part = 63 - __builtin_clzll(x);
+    // x / 2^int_part in [1, 2) as Q62
+    uint64_t m = uint64_t((unsigned __int128)(x) << PROB_BITS >> int_part);
+    int64_t res = int64_t(int_part) << FRAC_BITS;
+    for (int32_t bit = FRAC_BITS - 1; bit >= 0; bit--) {
+        m = uint64_t(((unsigned __int128)(m) * m) >> PROB_BITS);
+        // m is in [1, 4), the top bit tells if it reached 2
+        uint64_t top = m >> (PROB_BITS + 1);
+        m >>= top;
+        res |= int64_t(top) << bit;
+    }
+    return res;
+}
+
+// 2^y as Q62 for y <= 0. with y = -k - f, f in [0, 1), 2^y is
+// e^((1 - f) ln 2) / 2^(k + 1), the exponential by Horner's rule on its
+// Taylor series
+uint64_t ans_param_exp2(int64_t y)
+{
+    using namespace param_fixed;
+    uint64_t k = uint64_t(-y) >> FRAC_BITS;
+    if (k + 1 >= 64)
+        return 0;
+    uint64_t f = uint64_t(-y) & (ONE - 1);
+    uint64_t z = uint64_t(((unsigned __int128)(ONE - f) * LN2) >> FRAC_BITS);
+    const size_t num_terms = sizeof(INV_FACTORIAL) / sizeof(uint64_t);
+    uint64_t sum = INV_FACTORIAL[num_terms - 1];
+    for (size_t i = num_terms - 1; i != 0; i--) {
+        sum = INV_FACTORIAL[i - 1]
+            + uint64_t(((unsigned __int128)(sum) * z) >> PROB_BITS);
+    }
+    return sum >> (k + 1);
+}
+
+// geometric: the decay rate lambda = -ln(1 - p) on a log scale from 2^-16
+// to 2^16, returned as lambda log2(e) with FRAC_BITS fraction bits
+uint64_t ans_param_geometric_rate(uint32_t code)
+{
+    using namespace param_fixed;
+    // e = code / 2048 - 16 + log2(log2(e)) + FRAC_BITS is at most 49, so
+    // 2^e is the Q62 value of 2^(e - 49) shifted down by 62 - 49
+    int64_t e = int64_t(code) * (ONE / 2048) - 16 * ONE + LOG2_LOG2E
+        + FRAC_BITS * ONE;
+    return ans_param_exp2(e - 49 * ONE) >> 13;
+}
+
+// zipf: the exponent q from 0 to 4 is code / ZIPF_ONE
+const int64_t ZIPF_ONE = 16384;
+
+// smallest and largest value mapped to msb bucket sym
+void ans_msb_bucket_range(uint32_t sym, uint64_t& lo, uint64_t& hi)
+{
+    uint32_t except_bytes = ans_msb_exception_bytes(sym);
+    lo = ans_msb_undo_mapping(sym);
+    if (except_bytes == 0) {
+        hi = lo;
+        return;
+    }
+    uint64_t prev_max = 1ULL << (8 * except_bytes);
+    uint64_t max = except_bytes == 3 ? std::numeric_limits<uint32_t>::max()
+                                     : 1ULL << (8 * (except_bytes + 1));
+    hi = std::min(lo + prev_max - 1, max);
+    lo = std::max(lo, prev_max + 1);
+}
+
+// value range of an msb bucket and the log2 of a = lo + 0.5 and
+// b = hi + 1.5, the bounds of its zipf integral
+struct ans_param_bucket {
+    uint64_t lo;
+    uint64_t hi;
+    int64_t log2_a;
+    int64_t log2_b;
+};
+
+const std::vector<ans_param_bucket>& ans_param_buckets()
+{
+    static const auto buckets = [] {
+        std::vector<ans_param_bucket> b(msb_constants::MAX_SIGMA);
+        for (uint32_t sym = 0; sym < b.size(); sym++) {
+            ans_msb_bucket_range(sym, b[sym].lo, b[sym].hi);
+            b[sym].log2_a
+                = ans_param_log2(2 * b[sym].lo + 1) - param_fixed::ONE;
+            b[sym].log2_b
+                = ans_param_log2(2 * b[sym].hi + 3) - param_fixed::ONE;
+        }
+        return b;
+    }();
+    return buckets;
+}
+
+// unnormalized probability of every bucket as 2^log2_scale mass, the scale
+// with FRAC_BITS fraction bits and the mass as Q62. geometric: e^(-lambda lo)
+// (1 - e^(-lambda w)), w the width of the bucket. zipf: the integral of t^-q
+// from a to b, a^r ((b / a)^r - 1) / r with r = 1 - q, or a^r ln(b / a) for
+// r = 0. both masses are at most 2
+void ans_param_masses(uint8_t family, uint32_t code,
+    std::vector<int64_t>& log2_scale, std::vector<uint64_t>& mass)
+{
+    using namespace param_fixed;
+    const auto& buckets = ans_param_buckets();
+    if (family == param_constants::GEOMETRIC) {
+        uint64_t rate = ans_param_geometric_rate(code);
+        // consecutive buckets mostly have the same width
+        uint64_t prev_width = 0;
+        uint64_t tail = 0;
+        for (size_t sym = 0; sym < mass.size(); sym++) {
+            uint64_t width = buckets[sym].hi - buckets[sym].lo + 1;
+            if (width != prev_width) {
+                unsigned __int128 s = (unsigned __int128)(rate) * width;
+                tail = PROB_ONE;
+                if (s < 64 * ONE)
+                    tail -= ans_param_exp2(-int64_t(s));
+                prev_width = width;
+            }
+            unsigned __int128 t = (unsigned __int128)(rate) * buckets[sym].lo;
+            log2_scale[sym]
+                = -int64_t(std::min<unsigned __int128>(t, MAX_LOG2));
+            mass[sym] = tail;
+        }
+        return;
+    }
+    int64_t r = ZIPF_ONE - int64_t(code);
+    for (size_t sym = 0; sym < mass.size(); sym++) {
+        int64_t log2_a = buckets[sym].log2_a;
+        int64_t d = buckets[sym].log2_b - log2_a;
+        log2_scale[sym] = r * log2_a / ZIPF_ONE;
+        if (r == 0) {
+            mass[sym] = uint64_t(((unsigned __int128)(d) * LN2) >> FRAC_BITS);
+        } else {
+            // r d < 2, so 2^(r d) = 4 * 2^(r d - 2). rounding can put it
+            // on the wrong side of 1 if r d is tiny
+            int64_t g = r * d / ZIPF_ONE;
+            __int128 pow = (__int128)(ans_param_exp2(g - 2 * ONE)) << 2;
+            __int128 m = (pow - __int128(PROB_ONE)) * ZIPF_ONE / r;
+            mass[sym] = uint64_t(std::max<__int128>(m, 1));
+        }
+    }
+}
+
+struct ans_param_model {
+    uint8_t family;
+    uint32_t code;
+    uint32_t max_sym;
+    uint32_t frame_log2;
+    std::vector<std::pair<uint32_t, uint32_t>> corrections;
+
+    // frequencies of the symbols 0..max_sym summing to the frame size.
+    // every symbol gets at least one slot. returns false if the
+    // corrections leave too little room for the other symbols
+    bool normalize(std::vector<uint32_t>& nfreqs) const
+    {
+        uint64_t frame_size = 1ULL << frame_log2;
+        nfreqs.assign(max_sym + 1, 0);
+        std::vector<bool> fixed(max_sym + 1, false);
+        uint64_t sum = 0;
+        for (const auto& c : corrections) {
+            nfreqs[c.first] = c.second;
+            fixed[c.first] = true;
+            sum += c.second;
+        }
+        std::vector<int64_t> log2_scale(max_sym + 1, 0);
+        std::vector<uint64_t> mass(max_sym + 1, 0);
+        ans_param_masses(family, code, log2_scale, mass);
+        int64_t max_log2_scale = std::numeric_limits<int64_t>::min();
+        uint64_t num_free = 0;
+        for (uint32_t sym = 0; sym <= max_sym; sym++) {
+            if (fixed[sym])
+                continue;
+            max_log2_scale = std::max(max_log2_scale, log2_scale[sym]);
+            num_free++;
+        }
+        if (num_free == 0)
+            return sum == frame_size;
+        if (sum + num_free > frame_size)
+            return false;
+
+        // masses relative to the largest scale, shifted so that the sum of
+        // up to MAX_SIGMA of them fits 64 bits
+        uint64_t mass_sum = 0;
+        for (uint32_t sym = 0; sym <= max_sym; sym++) {
+            if (fixed[sym])
+                continue;
+            uint64_t rel = ans_param_exp2(log2_scale[sym] - max_log2_scale);
+            mass[sym] = uint64_t(((unsigned __int128)(rel) * mass[sym])
+                >> (param_fixed::PROB_BITS + 13));
+            mass_sum += mass[sym];
+        }
+
+        // one slot per free symbol, the rest shared by mass. the slots
+        // lost by rounding down go to the largest free symbol
+        uint64_t spare = frame_size - sum - num_free;
+        uint32_t largest = 0;
+        for (uint32_t sym = 0; sym <= max_sym; sym++) {
+            if (fixed[sym])
+                continue;
+            nfreqs[sym] = 1
+                + uint64_t((unsigned __int128)(mass[sym]) * spare / mass_sum);
+            sum += nfreqs[sym];
+            if (fixed[largest] || nfreqs[sym] > nfreqs[largest])
+                largest = sym;
+        }
+        nfreqs[largest] += frame_size - sum;
+        return true;
+    }
+
+    size_t serialize(uint8_t*& out_u8) const
+    {
+        auto start = out_u8;
+        *out_u8++ = family;
+        vbyte_encode_u32(out_u8, max_sym);
+        *out_u8++ = frame_log2;
+        vbyte_encode_u32(out_u8, code);
+        vbyte_encode_u32(out_u8, corrections.size());
+        uint32_t prev = 0;
+        for (const auto& c : corrections) {
+            vbyte_encode_u32(out_u8, c.first - prev);
+            vbyte_encode_u32(out_u8, c.second);
+            prev = c.first;
+        }
+        return out_u8 - start;
+    }
+
+    // the family byte has already been read
+    static ans_param_model load(uint8_t family, const uint8_t* in_u8)
+    {
+        ans_param_model model;
+        model.family = family;
+        model.max_sym = vbyte_decode_u32(in_u8);
+        model.frame_log2 = *in_u8++;
+        model.code = vbyte_decode_u32(in_u8);
+        uint32_t num_corrections = vbyte_decode_u32(in_u8);
+        uint32_t sym = 0;
+        for (uint32_t i = 0; i < num_corrections; i++) {
+            sym += vbyte_decode_u32(in_u8);
+            model.corrections.emplace_back(sym, vbyte_decode_u32(in_u8));
+        }
+        return model;
+    }
+};
+
+// bits needed to code the symbols with the given normalized frequencies
+double ans_param_cost(const std::vector<uint64_t>& freqs,
+    const std::vector<uint32_t>& nfreqs, uint32_t frame_log2)
+{
+    double bits = 0.0;
+    for (size_t sym = 0; sym < nfreqs.size(); sym++) {
+        if (freqs[sym] != 0)
+            bits += double(freqs[sym]) * (frame_log2 - std::log2(nfreqs[sym]));
+    }
+    return bits;
+}
+
+// fit the parameter by a narrowing grid search, then add the corrections
+// that pay for themselves. returns the total size in bits
+double ans_param_fit(ans_param_model& model, const std::vector<uint64_t>& freqs)
+{
+    std::vector<uint32_t> nfreqs;
+    auto cost = [&](uint32_t code) {
+        model.code = code;
+        model.normalize(nfreqs);
+        return ans_param_cost(freqs, nfreqs, model.frame_log2);
+    };
+    uint32_t best_code = 0;
+    double best_bits = std::numeric_limits<double>::max();
+    int64_t lo = 0;
+    int64_t hi = param_constants::MAX_CODE;
+    for (int64_t step = 1024; step >= 1; step /= 8) {
+        for (int64_t code = lo; code <= hi; code += step) {
+            double bits = cost(code);
+            if (bits < best_bits) {
+                best_bits = bits;
+                best_code = code;
+            }
+        }
+        lo = std::max<int64_t>(0, int64_t(best_code) - step);
+        hi = std::min<int64_t>(param_constants::MAX_CODE, best_code + step);
+    }
+    cost(best_code);
+
+    // candidate corrections: symbols whose ideal frequency gains the most
+    uint64_t n = std::accumulate(freqs.begin(), freqs.end(), 0ULL);
+    uint64_t frame_size = 1ULL << model.frame_log2;
+    std::vector<std::pair<double, uint32_t>> gains;
+    for (uint32_t sym = 0; sym <= model.max_sym; sym++) {
+        if (freqs[sym] == 0)
+            continue;
+        double ideal = std::max(1.0, double(freqs[sym]) * frame_size / n);
+        double gain = double(freqs[sym]) * std::log2(ideal / nfreqs[sym]);
+        if (gain > 0)
+            gains.emplace_back(gain, sym);
+    }
+    std::sort(gains.begin(), gains.end(),
+        std::greater<std::pair<double, uint32_t>>());
+
+    std::vector<uint8_t> tmp(16 + 10 * param_constants::MAX_CORRECTIONS);
+    auto total_bits = [&]() {
+        uint8_t* tmp_u8 = tmp.data();
+        return 8.0 * model.serialize(tmp_u8)
+            + ans_param_cost(freqs, nfreqs, model.frame_log2);
+    };
+    best_bits = total_bits();
+    auto best_corrections = model.corrections;
+    for (size_t k = 1; k <= param_constants::MAX_CORRECTIONS; k *= 2) {
+        if (k > gains.size())
+            break;
+        model.corrections.clear();
+        for (size_t i = 0; i < k; i++) {
+            uint32_t sym = gains[i].second;
+            uint32_t ideal = std::max<uint64_t>(
+                1, (freqs[sym] * frame_size + n / 2) / n);
+            model.corrections.emplace_back(sym, ideal);
+        }
+        std::sort(model.corrections.begin(), model.corrections.end());
+        if (!model.normalize(nfreqs))
+            continue;
+        double bits = total_bits();
+        if (bits < best_bits) {
+            best_bits = bits;
+            best_corrections = model.corrections;
+        }
+    }
+    model.corrections = best_corrections;
+    return best_bits;
+}
+
+size_t ans_msb_param_compress(
+    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+{
+    const uint32_t num_states = 4;
+    auto in_u32 = reinterpret_cast<const uint32_t*>(src);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+
+    std::vector<uint64_t> freqs(msb_constants::MAX_SIGMA, 0);
+    uint32_t max_sym = 0;
+    for (size_t i = 0; i < srcSize; i++) {
+        auto mapped_u32 = ans_msb_mapping(in_u32[i]);
+        freqs[mapped_u32]++;
+        max_sym = std::max(mapped_u32, max_sym);
+    }
+
+    // size of the regular prelude and payload
+    auto full_nfreqs = adjust_freqs(freqs, max_sym, true);
+    uint64_t full_frame_size = std::accumulate(
+        std::begin(full_nfreqs), std::end(full_nfreqs), 0ULL);
+    uint32_t full_frame_log2 = log2(full_frame_size);
+    std::vector<uint8_t> tmp(full_nfreqs.size() * 8 + 1024);
+    uint8_t* tmp_u8 = tmp.data();
+    double full_bits = 8.0
+            * ans_serialize_interp(full_nfreqs, full_frame_size, tmp_u8)
+        + ans_param_cost(freqs, full_nfreqs, full_frame_log2);
+
+    // best parametric model. all symbols up to max_sym get a slot so the
+    // frame is at least four times larger than the alphabet
+    ans_param_model best;
+    double best_bits = full_bits;
+    best.family = param_constants::INTERP;
+    for (auto family : { param_constants::GEOMETRIC, param_constants::ZIPF }) {
+        if (srcSize == 0)
+            break;
+        ans_param_model model;
+        model.family = family;
+        model.max_sym = max_sym;
+        model.frame_log2 = std::max<uint32_t>(
+            full_frame_log2, log2(next_power_of_two(4 * (max_sym + 1))));
+        double bits = ans_param_fit(model, freqs);
+        if (bits < best_bits) {
+            best_bits = bits;
+            best = model;
+        }
+    }
+
+    ans_msb_encode ans_frame;
+    if (best.family == param_constants::INTERP) {
+        *out_u8++ = param_constants::INTERP;
+        ans_frame = ans_msb_encode::create(full_nfreqs);
+        ans_frame.serialize(out_u8);
+    } else {
+        std::vector<uint32_t> nfreqs;
+        best.normalize(nfreqs);
+        ans_frame = ans_msb_encode::create(nfreqs);
+        best.serialize(out_u8);
+    }
+
+    std::array<uint64_t, num_states> states;
+
+    // start encoding
+    for (uint32_t i = 0; i < num_states; i++)
+        states[i] = ans_frame.initial_state();
+
+    size_t cur_sym = 0;
+    while ((srcSize - cur_sym) % num_states != 0) {
+        ans_frame.encode_symbol(
+            states[0], in_u32[srcSize - cur_sym - 1], out_u8);
+        cur_sym += 1;
+    }
+    while (cur_sym != srcSize) {
+        ans_frame.encode_symbol(
+            states[0], in_u32[srcSize - cur_sym - 1], out_u8);
+        ans_frame.encode_symbol(
+            states[1], in_u32[srcSize - cur_sym - 2], out_u8);
+        ans_frame.encode_symbol(
+            states[2], in_u32[srcSize - cur_sym - 3], out_u8);
+        ans_frame.encode_symbol(
+            states[3], in_u32[srcSize - cur_sym - 4], out_u8);
+        cur_sym += num_states;
+    }
+
+    // flush final state
+    for (uint32_t i = 0; i < num_states; i++)
+        ans_frame.flush_state(states[i], out_u8);
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+template <class t_output = identity_output>
+void ans_msb_param_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    uint8_t family = *in_u8++;
+    ans_msb_decode ans_frame;
+    if (family == param_constants::INTERP) {
+        ans_frame = ans_msb_decode::load(in_u8);
+    } else {
+        std::vector<uint32_t> nfreqs;
+        ans_param_model::load(family, in_u8).normalize(nfreqs);
+        ans_frame = ans_msb_decode::create(nfreqs);
+    }
+    ans_msb_decode_stream<t_output>(ans_frame, dst, to_decode, cSrc + cSrcSize);
+}
@@ -0,0 +1,232 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* Paired stream codec for (length, offset) factors.
+
+   The input is a list of interleaved tuples len_0, off_0, len_1, off_1, ...
+   as produced by an RLZ factorization. Lengths and offsets are coded with
+   separate msb models in one interleaved ANS stream, so a single decode
+   loop emits whole tuples: of the 4 states, states 0 and 2 always decode
+   lengths and states 1 and 3 offsets. With max_off_contexts > 1 the offset
+   model is selected by the msb bucket of the length of the same tuple,
+   using the context machinery of ans_msb_o1.hpp: context 0 codes the
+   lengths, the most frequent length buckets get an offset context of
+   their own and the remaining buckets share one. The entries of the
+   length table store the offset context, so the decoder never maps a
+   length back to its bucket. An odd number of values is allowed, the
+   last tuple then has no offset.
+*/
+
+#include "ans_msb_o1.hpp"
+
+struct ans_pair_encode : ans_msb_o1_encode {
+    static ans_pair_encode create(
+        const uint32_t* in_u32, size_t n, uint32_t max_off_contexts)
+    {
+        ans_pair_encode model;
+        std::vector<uint64_t> len_freqs(msb_constants::MAX_SIGMA, 0);
+        for (size_t i = 1; i < n; i += 2) {
+            len_freqs[ans_msb_mapping(in_u32[i - 1])]++;
+        }
+        uint32_t num_contexts
+            = model.select_buckets(len_freqs, max_off_contexts, 1);
+        model.build_contexts(in_u32, n, num_contexts,
+            [&](size_t i) { return model.context(in_u32, i); });
+        return model;
+    }
+
+    uint32_t context(const uint32_t* in_u32, size_t i) const
+    {
+        if (i % 2 == 0)
+            return 0;
+        return ctx_of_bucket[ans_msb_mapping(in_u32[i - 1])];
+    }
+};
+
+struct ans_pair_decode : ans_msb_o1_decode {
+    static ans_pair_decode load(const uint8_t* in_u8)
+    {
+        ans_pair_decode model;
+        uint32_t num_contexts = vbyte_decode_u32(in_u8);
+        uint32_t num_buckets = vbyte_decode_u32(in_u8);
+        std::vector<uint32_t> ctx_of_bucket(msb_constants::MAX_SIGMA,
+            std::min(1 + num_buckets, num_contexts - 1));
+        for (uint32_t c = 0; c < num_buckets; c++) {
+            ctx_of_bucket[vbyte_decode_u32(in_u8)] = 1 + c;
+        }
+
+        auto nfreqs = ans_msb_o1_load_freqs(in_u8, num_contexts);
+        std::vector<uint32_t> packed(num_contexts);
+        std::vector<uint64_t> starts(num_contexts);
+        uint64_t max_frame_size = 1;
+        uint64_t total_size = 0;
+        for (uint32_t c = 0; c < num_contexts; c++) {
+            uint64_t frame_size = std::accumulate(
+                std::begin(nfreqs[c]), std::end(nfreqs[c]), 0);
+            starts[c] = total_size;
+            // empty input leaves a context without symbols
+            packed[c] = (total_size << 5)
+                | uint32_t(log2(std::max<uint64_t>(frame_size, 1)));
+            max_frame_size = std::max(max_frame_size, frame_size);
+            total_size += frame_size;
+        }
+        model.start_ctx = packed[0];
+        model.off_ctx = packed[num_contexts - 1];
+        model.conditioned = num_contexts > 2;
+
+        // length entries point to the offset context of their bucket,
+        // offset entries back to the length context
+        model.table.resize(total_size);
+        for (uint32_t c = 0; c < num_contexts; c++) {
+            auto table = model.table.data() + starts[c];
+            uint32_t cur_base = 0;
+            for (size_t sym = 0; sym < nfreqs[c].size(); sym++) {
+                auto cur_freq = nfreqs[c][sym];
+                uint32_t except_bytes = ans_msb_exception_bytes(sym);
+                uint32_t next_ctx
+                    = c == 0 ? packed[ctx_of_bucket[sym]] : packed[0];
+                for (uint32_t k = 0; k < cur_freq; k++) {
+                    table[cur_base + k].entry.freq = cur_freq;
+                    table[cur_base + k].entry.mapped_num
+                        = ans_msb_undo_mapping(sym) + (except_bytes << 30);
+                    table[cur_base + k].entry.offset = k;
+                    table[cur_base + k].next_ctx = next_ctx;
+                }
+                cur_base += cur_freq;
+            }
+        }
+        model.lower_bound = constants::K * max_frame_size;
+        return model;
+    }
+
+    // unlike ans_msb_o1 the states are independent across tuples, so the
+    // renormalization branch is kept and the states overlap as in ans_msb
+    uint32_t decode_sym(uint64_t& state, uint32_t& c, const uint8_t*& in_u8)
+    {
+        uint32_t frame_log2 = c & 31;
+        uint64_t frame_mask = (1ULL << frame_log2) - 1;
+        const auto& e = table[(c >> 5) + (state & frame_mask)];
+        state = uint64_t(e.entry.freq) * (state >> frame_log2)
+            + uint64_t(e.entry.offset);
+        if (state < lower_bound) {
+            in_u8 -= sizeof(uint32_t);
+            auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
+            state = state << constants::RADIX_LOG2 | uint64_t(*in_ptr_u32);
+        }
+        c = e.next_ctx;
+        return ans_msb_undo_mapping(e.entry, in_u8);
+    }
+
+    uint32_t off_ctx;
+    bool conditioned;
+};
+
+template <uint32_t max_off_contexts>
+size_t ans_pair_compress(
+    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+{
+    static_assert(max_off_contexts >= 1, "need at least one context");
+    const uint32_t num_states = 4;
+    auto in_u32 = reinterpret_cast<const uint32_t*>(src);
+    auto ans_frame = ans_pair_encode::create(in_u32, srcSize, max_off_contexts);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+
+    // serialize model
+    ans_frame.serialize(out_u8);
+
+    std::array<uint64_t, num_states> states;
+
+    // start encoding
+    for (uint32_t i = 0; i < num_states; i++)
+        states[i] = ans_frame.initial_state();
+
+    size_t cur_sym = 0;
+    while ((srcSize - cur_sym) % num_states != 0) {
+        size_t i = srcSize - cur_sym - 1;
+        ans_frame.encode_symbol(
+            states[0], in_u32[i], ans_frame.context(in_u32, i), out_u8);
+        cur_sym += 1;
+    }
+    while (cur_sym != srcSize) {
+        for (uint32_t j = 0; j < num_states; j++) {
+            size_t i = srcSize - cur_sym - 1 - j;
+            ans_frame.encode_symbol(
+                states[j], in_u32[i], ans_frame.context(in_u32, i), out_u8);
+        }
+        cur_sym += num_states;
+    }
+
+    // flush final state
+    for (uint32_t i = 0; i < num_states; i++)
+        ans_frame.flush_state(states[i], out_u8);
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+// without conditioning the offset context is fixed, so the offset does not
+// wait for the length entry either
+template <bool t_conditioned>
+void ans_pair_decode_tuples(ans_pair_decode& ans_frame, const uint8_t* in_u8,
+    uint32_t* out_u32, size_t to_decode)
+{
+    const uint32_t num_states = 4;
+    std::array<uint64_t, num_states> states;
+
+    for (uint32_t i = 0; i < num_states; i++) {
+        states[i] = ans_frame.init_state(in_u8);
+    }
+
+    const uint32_t len_ctx = ans_frame.start_ctx;
+    const uint32_t off_ctx = ans_frame.off_ctx;
+    size_t cur_idx = 0;
+    size_t fast_decode = to_decode - (to_decode % num_states);
+    while (cur_idx != fast_decode) {
+        uint32_t ctx = len_ctx;
+        out_u32[cur_idx] = ans_frame.decode_sym(states[0], ctx, in_u8);
+        if (!t_conditioned)
+            ctx = off_ctx;
+        out_u32[cur_idx + 1] = ans_frame.decode_sym(states[1], ctx, in_u8);
+        ctx = len_ctx;
+        out_u32[cur_idx + 2] = ans_frame.decode_sym(states[2], ctx, in_u8);
+        if (!t_conditioned)
+            ctx = off_ctx;
+        out_u32[cur_idx + 3] = ans_frame.decode_sym(states[3], ctx, in_u8);
+        cur_idx += num_states;
+    }
+    uint32_t ctx = len_ctx;
+    while (cur_idx != to_decode) {
+        out_u32[cur_idx++]
+            = ans_frame.decode_sym(states[num_states - 1], ctx, in_u8);
+    }
+}
+
+void ans_pair_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    auto ans_frame = ans_pair_decode::load(in_u8);
+    in_u8 += cSrcSize;
+
+    auto out_u32 = reinterpret_cast<uint32_t*>(dst);
+    if (ans_frame.conditioned) {
+        ans_pair_decode_tuples<true>(ans_frame, in_u8, out_u32, to_decode);
+    } else {
+        ans_pair_decode_tuples<false>(ans_frame, in_u8, out_u32, to_decode);
+    }
+}
@@ -0,0 +1,207 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* Patched frame of reference with entropy coded metadata.
+
+   As in OptPFor the input is cut into blocks of 128 values, and the low b
+   bits of every value are bit packed with the SIMD routines of FastPFor.
+   Values that need more than b bits are exceptions: their position in the
+   block and their high bits are patched in after unpacking. Unlike OptPFor
+   the per block selector (b and the number of exceptions), the exception
+   positions and the exception high bits are not stored in fixed width
+   fields but as three ans_msb coded streams, so skewed widths and
+   exception values cost close to their entropy. b is chosen per block to
+   minimize packed bits plus an estimate of the coded exception cost. The
+   decoder expands the three streams first, most values are then decoded
+   at bit unpacking speed.
+
+   Layout: uint32 stored size of the selector, position and high bit
+   streams, the three ans_msb streams, the packed blocks (16 * b bytes
+   each, the last block is zero padded).
+*/
+
+#include "ans_msb.hpp"
+#include "usimdbitpacking.h"
+
+namespace pfor_constants {
+const uint32_t BLOCK_SIZE = 128;
+const uint32_t WIDTH_BITS = 6;
+const uint32_t WIDTH_MASK = (1 << WIDTH_BITS) - 1;
+// estimated bits of a coded exception on top of its high bits
+const uint32_t EXCEPTION_COST = 8;
+// ans_msb keeps 30 bits of a value in its decode table
+const uint32_t MAX_HIGH_BITS = 30;
+}
+
+// bits needed to store x, 0 for x = 0
+inline uint32_t ans_pfor_bits(uint32_t x)
+{
+    return x == 0 ? 0 : 32 - __builtin_clz(x);
+}
+
+// the width that minimizes packed plus exception bits of a block. the
+// high bits of an exception have to fit ans_msb
+uint32_t ans_pfor_select_width(const uint32_t* block)
+{
+    std::array<uint32_t, 33> count {};
+    for (uint32_t i = 0; i < pfor_constants::BLOCK_SIZE; i++)
+        count[ans_pfor_bits(block[i])]++;
+    uint32_t max_bits = 32;
+    while (max_bits != 0 && count[max_bits] == 0)
+        max_bits--;
+
+    uint32_t best_width = max_bits;
+    uint64_t best_cost = uint64_t(max_bits) * pfor_constants::BLOCK_SIZE;
+    uint32_t min_width = max_bits > pfor_constants::MAX_HIGH_BITS
+        ? max_bits - pfor_constants::MAX_HIGH_BITS
+        : 0;
+    for (uint32_t width = min_width; width < max_bits; width++) {
+        uint64_t cost = uint64_t(width) * pfor_constants::BLOCK_SIZE;
+        for (uint32_t bits = width + 1; bits <= max_bits; bits++) {
+            cost += uint64_t(count[bits])
+                * (bits - width + pfor_constants::EXCEPTION_COST);
+        }
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_width = width;
+        }
+    }
+    return best_width;
+}
+
+// codes values with ans_msb, an empty stream takes no bytes
+size_t ans_pfor_store(uint8_t*& out_u8, size_t capacity,
+    const std::vector<uint32_t>& values, uint32_t* stored_bytes)
+{
+    *stored_bytes = 0;
+    if (!values.empty()) {
+        *stored_bytes = ans_msb_compress(
+            out_u8, capacity, values.data(), values.size());
+    }
+    out_u8 += *stored_bytes;
+    return *stored_bytes;
+}
+
+size_t ans_pfor_compress(
+    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+{
+    const uint32_t B = pfor_constants::BLOCK_SIZE;
+    auto in_u32 = reinterpret_cast<const uint32_t*>(src);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+    size_t num_blocks = (srcSize + B - 1) / B;
+
+    // (1) choose the widths and split off the exceptions
+    std::vector<uint32_t> selectors(num_blocks);
+    std::vector<uint32_t> positions;
+    std::vector<uint32_t> highs;
+    std::vector<uint32_t> low_bits(num_blocks * B, 0);
+    std::copy(in_u32, in_u32 + srcSize, low_bits.begin());
+    for (size_t b = 0; b < num_blocks; b++) {
+        uint32_t* block = low_bits.data() + b * B;
+        uint32_t width = ans_pfor_select_width(block);
+        uint32_t num_exceptions = 0;
+        if (width != 32) {
+            for (uint32_t i = 0; i < B; i++) {
+                if ((block[i] >> width) != 0) {
+                    positions.push_back(i);
+                    highs.push_back(block[i] >> width);
+                    block[i] &= (1U << width) - 1;
+                    num_exceptions++;
+                }
+            }
+        }
+        selectors[b] = width | (num_exceptions << pfor_constants::WIDTH_BITS);
+    }
+
+    // (2) code the metadata
+    auto stored_bytes = reinterpret_cast<uint32_t*>(out_u8);
+    out_u8 += 3 * sizeof(uint32_t);
+    ans_pfor_store(out_u8, dstCapacity - (out_u8 - dst), selectors,
+        stored_bytes + 0);
+    ans_pfor_store(out_u8, dstCapacity - (out_u8 - dst), positions,
+        stored_bytes + 1);
+    ans_pfor_store(
+        out_u8, dstCapacity - (out_u8 - dst), highs, stored_bytes + 2);
+
+    // (3) pack the low bits
+    for (size_t b = 0; b < num_blocks; b++) {
+        uint32_t width = selectors[b] & pfor_constants::WIDTH_MASK;
+        FastPForLib::usimdpack(low_bits.data() + b * B,
+            reinterpret_cast<__m128i*>(out_u8), width);
+        out_u8 += width * sizeof(__m128i);
+    }
+
+    return out_u8 - reinterpret_cast<uint8_t*>(dst);
+}
+
+void ans_pfor_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    const uint32_t B = pfor_constants::BLOCK_SIZE;
+    auto in_u8 = reinterpret_cast<const uint8_t*>(cSrc);
+    size_t num_blocks = (to_decode + B - 1) / B;
+
+    // (1) expand the metadata
+    uint32_t stored_bytes[3];
+    memcpy(stored_bytes, in_u8, sizeof(stored_bytes));
+    in_u8 += sizeof(stored_bytes);
+    std::vector<uint32_t> selectors(num_blocks);
+    if (num_blocks != 0) {
+        ans_msb_decompress(
+            selectors.data(), num_blocks, in_u8, stored_bytes[0]);
+    }
+    in_u8 += stored_bytes[0];
+    size_t num_exceptions = 0;
+    for (auto selector : selectors)
+        num_exceptions += selector >> pfor_constants::WIDTH_BITS;
+    std::vector<uint32_t> positions(num_exceptions);
+    std::vector<uint32_t> highs(num_exceptions);
+    if (num_exceptions != 0) {
+        ans_msb_decompress(
+            positions.data(), num_exceptions, in_u8, stored_bytes[1]);
+        in_u8 += stored_bytes[1];
+        ans_msb_decompress(
+            highs.data(), num_exceptions, in_u8, stored_bytes[2]);
+        in_u8 += stored_bytes[2];
+    }
+
+    // (2) unpack and patch the blocks, the last one through a buffer
+    auto out_u32 = reinterpret_cast<uint32_t*>(dst);
+    const uint32_t* position = positions.data();
+    const uint32_t* high = highs.data();
+    uint32_t last_block[B];
+    for (size_t b = 0; b < num_blocks; b++) {
+        uint32_t width = selectors[b] & pfor_constants::WIDTH_MASK;
+        uint32_t block_exceptions
+            = selectors[b] >> pfor_constants::WIDTH_BITS;
+        bool last = (b + 1) * B > to_decode;
+        uint32_t* block = last ? last_block : out_u32 + b * B;
+        FastPForLib::usimdunpack(
+            reinterpret_cast<const __m128i*>(in_u8), block, width);
+        in_u8 += width * sizeof(__m128i);
+        for (uint32_t j = 0; j < block_exceptions; j++) {
+            block[position[j]] |= high[j] << width;
+        }
+        position += block_exceptions;
+        high += block_exceptions;
+        if (last) {
+            std::copy(block, block + (to_decode - b * B), out_u32 + b * B);
+        }
+    }
+}
@@ -190,32 +190,34 @@ struct dec_entry_reorder_fold {
     uint32_t mapped_num;
 };
 
-uint32_t ans_reorder_fold_undo_mapping(
+// adds the exception bytes of the entry, if any, to the stored value.
+// there is no branch for entries without exception bytes, as inputs with
+// exceptions mix them unpredictably with plain values
+inline uint32_t ans_reorder_fold_undo_mapping(
     const dec_entry_reorder_fold& entry, const uint8_t*& in_u8)
 {
     uint32_t except_bytes = entry.mapped_num >> 30;
-    uint32_t mapped_num = entry.mapped_num & 0x3FFFFFFF;
     static std::array<uint32_t, 4> except_mask
         = { 0x0, 0xFF, 0xFFFF, 0xFFFFFF };
-    auto u32_ptr = in_u8 - except_bytes;
-    auto except_u32 = reinterpret_cast<const uint32_t*>(u32_ptr);
-    uint32_t num = mapped_num + (*except_u32 & except_mask[except_bytes]);
     in_u8 -= except_bytes;
-    return num;
+    auto except_u32 = reinterpret_cast<const uint32_t*>(in_u8);
+    uint32_t mapped_num = entry.mapped_num & 0x3FFFFFFF;
+    return mapped_num + (*except_u32 & except_mask[except_bytes]);
 }
 
 template <uint32_t fidelity>
 uint32_t ans_reorder_fold_undo_mapping(
-    std::vector<uint32_t>& most_frequent, uint32_t x_plus_offset)
+    const std::vector<uint32_t>& most_frequent, uint32_t shift,
+    uint32_t x_plus_offset)
 {
     const uint32_t radix = 8;
     uint32_t div = (1 << (fidelity - 1)) * ((1 << radix) - 1);
     size_t thres = 1 << (fidelity + radix - 1);
     if (x_plus_offset < thres)
-        return most_frequent[x_plus_offset] + thres;
+        return most_frequent[x_plus_offset];
     auto output_bytes = (x_plus_offset - thres) / div + 1;
     auto x_org = x_plus_offset - (div * output_bytes);
-    return x_org << (radix * output_bytes);
+    return (x_org << (radix * output_bytes)) - shift;
 }
 
 template <uint32_t fidelity>
@@ -240,6 +242,7 @@ template <uint32_t fidelity> struct ans_reorder_fold_decode {
         uint32_t do_reorder = *in_ptr_u32++;
         size_t no_except_thres = 1 << (fidelity + 8 - 1);
         std::vector<uint32_t> most_frequent(no_except_thres);
+        uint32_t shift = do_reorder == 1 ? no_except_thres : 0;
         if (do_reorder == 1) {
             for (size_t i = 0; i < no_except_thres; i++) {
                 most_frequent[i] = *in_ptr_u32++;
@@ -260,13 +263,15 @@ template <uint32_t fidelity> struct ans_reorder_fold_decode {
         auto max_sym = model.nfreqs.size() - 1;
         uint64_t tmp = constants::K * constants::RADIX;
         uint32_t cur_base = 0;
+        // the entries hold the original value, so only symbols with
+        // exception bytes need more work in decode_sym
         for (size_t sym = 0; sym <= max_sym; sym++) {
             auto cur_freq = model.nfreqs[sym];
             uint32_t except_bytes
                 = ans_reorder_fold_exception_bytes<fidelity>(sym);
-            uint32_t mapped_num
-                = ans_reorder_fold_undo_mapping<fidelity>(most_frequent, sym)
-                + (except_bytes << 30);
+            uint32_t value = ans_reorder_fold_undo_mapping<fidelity>(
+                most_frequent, shift, sym);
+            uint32_t mapped_num = value + (except_bytes << 30);
             for (uint32_t k = 0; k < cur_freq; k++) {
                 model.table[cur_base + k].freq = cur_freq;
                 model.table[cur_base + k].mapped_num = mapped_num;
@@ -287,8 +292,6 @@ template <uint32_t fidelity> struct ans_reorder_fold_decode {
 
     uint32_t decode_sym(uint64_t& state, const uint8_t*& in_u8)
     {
-        const uint32_t radix = 8;
-        const size_t thres = 1 << (fidelity + radix - 1);
         const auto& entry = table[state & frame_mask];
         state = uint64_t(entry.freq) * (state >> frame_log2)
             + uint64_t(entry.offset);
@@ -297,8 +300,7 @@ template <uint32_t fidelity> struct ans_reorder_fold_decode {
             auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_u8);
             state = state << constants::RADIX_LOG2 | uint64_t(*in_ptr_u32);
         }
-        auto decoded_sym = ans_reorder_fold_undo_mapping(entry, in_u8);
-        return decoded_sym - thres;
+        return ans_reorder_fold_undo_mapping(entry, in_u8);
     }
 
     std::vector<uint32_t> nfreqs;
@@ -306,7 +308,7 @@ template <uint32_t fidelity> struct ans_reorder_fold_decode {
     uint64_t frame_mask;
     uint64_t frame_log2;
     uint64_t lower_bound;
-    std::vector<dec_entry_reorder_fold> table;
+    table_vector<dec_entry_reorder_fold> table;
 };
 
 template <uint32_t fidelity>
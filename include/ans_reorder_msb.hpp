@@ -0,0 +1,159 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* ans_msb with the most frequent values ranked to the front.
+
+   The msb mapping codes values up to 256 exactly, larger values share a
+   bucket and pay exception bytes. If frequent values are large, as for
+   round numbers or ids, they end up in sparse buckets and every
+   occurrence costs exception bytes. Here up to MAX_RANKED of the most
+   frequent values (counted with a hash map, so the histogram is
+   O(sigma)) are replaced by their rank, all other values are shifted up
+   by the number of ranked values and the result is coded with ans_msb.
+   No values are ranked if the estimated size of the ranked stream plus
+   the ranked values in the prelude is not smaller than without ranking.
+
+   The decoder does not undo the ranking separately: after building the
+   ans_msb decode table the value stored in every entry is replaced by the
+   original value, the ranked value for entries of a rank and the value
+   shifted back down for all others, so decoding costs the same as
+   ans_msb.
+
+   Layout: uint32 number of ranked values, the ranked values as uint32 in
+   rank order, ans_msb prelude, ans_msb stream (read backwards as in
+   ans_msb).
+*/
+
+#include "ans_msb.hpp"
+
+namespace reorder_msb_constants {
+// at most the values that ans_msb codes without exception bytes
+const uint32_t MAX_RANKED = 256;
+// ranked values are stored in the 30 bit value field of dec_entry_msb
+const uint32_t MAX_RANKED_VALUE = (1U << 30) - 1;
+}
+
+// estimated bits of coding values with frequencies freqs with ans_msb
+// after replacing the values in ranked by their rank
+double ans_reorder_msb_cost(const std::unordered_map<uint32_t, uint64_t>& freqs,
+    const std::unordered_map<uint32_t, uint32_t>& rank)
+{
+    std::vector<uint64_t> bucket_freqs(msb_constants::MAX_SIGMA, 0);
+    uint64_t n = 0;
+    double bits = 32.0 * rank.size();
+    for (const auto& f : freqs) {
+        auto itr = rank.find(f.first);
+        uint32_t x = itr != rank.end() ? itr->second : f.first + rank.size();
+        auto sym = ans_msb_mapping(x);
+        bucket_freqs[sym] += f.second;
+        bits += 8.0 * ans_msb_exception_bytes(sym) * f.second;
+        n += f.second;
+    }
+    return bits + n * entropy(bucket_freqs, n);
+}
+
+// the ranked values in rank order, most frequent first. empty if ranking
+// does not pay for the ranked values stored in the prelude
+std::vector<uint32_t> ans_reorder_msb_ranking(
+    const uint32_t* in_u32, size_t n)
+{
+    std::unordered_map<uint32_t, uint64_t> freqs;
+    for (size_t i = 0; i < n; i++)
+        freqs[in_u32[i]]++;
+    std::vector<std::pair<uint64_t, uint32_t>> by_freq;
+    for (const auto& f : freqs) {
+        if (f.first <= reorder_msb_constants::MAX_RANKED_VALUE)
+            by_freq.emplace_back(f.second, f.first);
+    }
+    size_t num_ranked = std::min<size_t>(
+        by_freq.size(), reorder_msb_constants::MAX_RANKED);
+    std::partial_sort(by_freq.begin(), by_freq.begin() + num_ranked,
+        by_freq.end(), [](const auto& a, const auto& b) {
+            return a.first > b.first
+                || (a.first == b.first && a.second < b.second);
+        });
+    std::vector<uint32_t> ranked(num_ranked);
+    std::unordered_map<uint32_t, uint32_t> rank;
+    for (uint32_t r = 0; r < num_ranked; r++) {
+        ranked[r] = by_freq[r].second;
+        rank[ranked[r]] = r;
+    }
+    if (ans_reorder_msb_cost(freqs, rank) >= ans_reorder_msb_cost(freqs, {}))
+        ranked.clear();
+    return ranked;
+}
+
+size_t ans_reorder_msb_compress(
+    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+{
+    auto in_u32 = reinterpret_cast<const uint32_t*>(src);
+    uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
+    auto ranked = ans_reorder_msb_ranking(in_u32, srcSize);
+    uint32_t num_ranked = ranked.size();
+    memcpy(out_u8, &num_ranked, sizeof(uint32_t));
+    out_u8 += sizeof(uint32_t);
+    memcpy(out_u8, ranked.data(), num_ranked * sizeof(uint32_t));
+    out_u8 += num_ranked * sizeof(uint32_t);
+
+    std::unordered_map<uint32_t, uint32_t> rank;
+    for (uint32_t r = 0; r < num_ranked; r++)
+        rank[ranked[r]] = r;
+    std::vector<uint32_t> remapped(srcSize);
+    for (size_t i = 0; i < srcSize; i++) {
+        auto itr = rank.find(in_u32[i]);
+        remapped[i] = itr != rank.end() ? itr->second : in_u32[i] + num_ranked;
+    }
+
+    size_t prelude_bytes = out_u8 - dst;
+    return prelude_bytes
+        + ans_msb_compress(out_u8, dstCapacity - prelude_bytes,
+            remapped.data(), srcSize);
+}
+
+// the ans_msb decode table with the ranking folded in
+ans_msb_decode ans_reorder_msb_load(const uint8_t*& in_u8)
+{
+    uint32_t num_ranked;
+    memcpy(&num_ranked, in_u8, sizeof(uint32_t));
+    in_u8 += sizeof(uint32_t);
+    std::vector<uint32_t> ranked(num_ranked);
+    memcpy(ranked.data(), in_u8, num_ranked * sizeof(uint32_t));
+    in_u8 += num_ranked * sizeof(uint32_t);
+
+    auto ans_frame = ans_msb_decode::load(in_u8);
+    for (auto& entry : ans_frame.table) {
+        // no exception bytes and a value below num_ranked: a rank
+        if (entry.mapped_num < num_ranked) {
+            entry.mapped_num = ranked[entry.mapped_num];
+        } else {
+            entry.mapped_num -= num_ranked;
+        }
+    }
+    return ans_frame;
+}
+
+template <class t_output = identity_output>
+void ans_reorder_msb_decompress(
+    uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
+{
+    auto in_u8 = cSrc;
+    auto ans_frame = ans_reorder_msb_load(in_u8);
+    ans_msb_decode_stream<t_output>(
+        ans_frame, dst, to_decode, cSrc + cSrcSize);
+}
@@ -17,6 +17,10 @@
 
 #pragma once
 
+// ans_int with the approximation ratio of adjust_freqs as a runtime argument
+// of the encoder, stored vbyte coded in front of the prelude. used for the
+// trade-offs of Fig. 12 in the paper
+
 #include "ans_util.hpp"
 
 #ifdef RECORD_STATS
@@ -35,10 +39,12 @@ struct enc_entry_sint {
     uint64_t sym_upper_bound;
 };
 
-template <uint32_t H_approx> struct ans_sint_encode {
-    static ans_sint_encode create(const uint32_t* in_u32, size_t n)
+struct ans_sint_encode {
+    static ans_sint_encode create(
+        const uint32_t* in_u32, size_t n, uint32_t H_approx)
     {
         ans_sint_encode model;
+        model.H_approx = H_approx;
         uint32_t max_sym = 0;
         for (size_t i = 0; i < n; i++) {
             max_sym = std::max(in_u32[i], max_sym);
@@ -66,9 +72,13 @@ template <uint32_t H_approx> struct ans_sint_encode {
         return model;
     }
 
+    // the approximation ratio in front of the prelude
     size_t serialize(uint8_t*& out_u8)
     {
-        return ans_serialize_interp(nfreqs, frame_size, out_u8);
+        auto start = out_u8;
+        vbyte_encode_u32(out_u8, H_approx);
+        ans_serialize_interp(nfreqs, frame_size, out_u8);
+        return out_u8 - start;
     }
 
     void encode_symbol(uint64_t& state, uint32_t sym, uint8_t*& out_u8)
@@ -91,6 +101,7 @@ template <uint32_t H_approx> struct ans_sint_encode {
         out_u8 += sizeof(uint64_t);
     }
 
+    uint32_t H_approx;
     std::vector<uint32_t> nfreqs;
     std::vector<enc_entry_sint> table;
     uint64_t frame_size;
@@ -116,6 +127,7 @@ struct ans_sint_decode {
     static ans_sint_decode load(const uint8_t* in_u8)
     {
         ans_sint_decode model;
+        model.H_approx = vbyte_decode_u32(in_u8);
         model.nfreqs = ans_load_interp(in_u8);
         auto max_norm_freq
             = *std::max_element(model.nfreqs.begin(), model.nfreqs.end());
@@ -185,18 +197,37 @@ struct ans_sint_decode {
         return entry.sym;
     }
 
+    // see ans_int_decode::decode_sym_prefetch
+    template <class t_entry>
+    uint32_t decode_sym_prefetch(uint64_t& state, const uint8_t*& in_u8)
+    {
+        auto tbl = reinterpret_cast<const t_entry*>(table.data());
+        const auto& entry = tbl[state & frame_mask];
+        state = uint64_t(entry.freq) * (state >> frame_log2)
+            + uint64_t(entry.offset);
+        uint32_t next_u32;
+        memcpy(&next_u32, in_u8 - sizeof(uint32_t), sizeof(uint32_t));
+        __builtin_prefetch(tbl + (state & frame_mask));
+        __builtin_prefetch(tbl + (next_u32 & frame_mask));
+        if (state < lower_bound) {
+            in_u8 -= sizeof(uint32_t);
+            state = state << constants::RADIX_LOG2 | uint64_t(next_u32);
+        }
+        return entry.sym;
+    }
+
+    uint32_t H_approx;
     std::vector<uint32_t> nfreqs;
     uint64_t frame_size;
     uint64_t frame_mask;
     uint64_t frame_log2;
     uint64_t lower_bound;
     dec_table_type_sint table_type;
-    std::vector<uint8_t> table;
+    table_vector<uint8_t> table;
 };
 
-template <uint32_t H_approx>
-size_t ans_sint_compress(
-    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+size_t ans_sint_compress(uint8_t* dst, size_t dstCapacity, const uint32_t* src,
+    size_t srcSize, uint32_t H_approx)
 {
     const uint32_t num_states = 4;
 #ifdef RECORD_STATS
@@ -204,7 +235,7 @@ size_t ans_sint_compress(
 #endif
 
     auto in_u32 = reinterpret_cast<const uint32_t*>(src);
-    auto ans_frame = ans_sint_encode<H_approx>::create(in_u32, srcSize);
+    auto ans_frame = ans_sint_encode::create(in_u32, srcSize, H_approx);
     uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
 
     // serialize model
@@ -255,6 +286,30 @@ size_t ans_sint_compress(
     return out_u8 - reinterpret_cast<uint8_t*>(dst);
 }
 
+// as ans_int_decode_states
+template <class t_entry, bool t_prefetch>
+void ans_sint_decode_states(ans_sint_decode& ans_frame,
+    std::array<uint64_t, 4>& states, const uint8_t* in_u8, uint32_t* out_u32,
+    size_t to_decode)
+{
+    const uint32_t num_states = 4;
+    size_t cur_idx = 0;
+    size_t fast_decode = to_decode - (to_decode % num_states);
+    while (cur_idx != fast_decode) {
+        for (uint32_t j = 0; j < num_states; j++) {
+            out_u32[cur_idx + j] = t_prefetch
+                ? ans_frame.decode_sym_prefetch<t_entry>(states[j], in_u8)
+                : ans_frame.decode_sym<t_entry>(states[j], in_u8);
+        }
+        cur_idx += num_states;
+    }
+    while (cur_idx != to_decode) {
+        out_u32[cur_idx++]
+            = ans_frame.decode_sym<t_entry>(states[num_states - 1], in_u8);
+    }
+}
+
+template <table_prefetch t_prefetch = PREFETCH_AUTO>
 void ans_sint_decompress(
     uint32_t* dst, size_t to_decode, const uint8_t* cSrc, size_t cSrcSize)
 {
@@ -268,40 +323,23 @@ void ans_sint_decompress(
     for (uint32_t i = 0; i < num_states; i++) {
         states[i] = ans_frame.init_state(in_u8);
     }
-    size_t cur_idx = 0;
     auto out_u32 = reinterpret_cast<uint32_t*>(dst);
-    size_t fast_decode = to_decode - (to_decode % num_states);
+    bool prefetch = use_prefetch(t_prefetch, ans_frame.table.size());
     if (ans_frame.table_type == dec_table_type_sint::SINT_SMALL) {
-        while (cur_idx != fast_decode) {
-            out_u32[cur_idx]
-                = ans_frame.decode_sym<dec_entry_sint_small>(states[0], in_u8);
-            out_u32[cur_idx + 1]
-                = ans_frame.decode_sym<dec_entry_sint_small>(states[1], in_u8);
-            out_u32[cur_idx + 2]
-                = ans_frame.decode_sym<dec_entry_sint_small>(states[2], in_u8);
-            out_u32[cur_idx + 3]
-                = ans_frame.decode_sym<dec_entry_sint_small>(states[3], in_u8);
-            cur_idx += num_states;
-        }
-        while (cur_idx != to_decode) {
-            out_u32[cur_idx++] = ans_frame.decode_sym<dec_entry_sint_small>(
-                states[num_states - 1], in_u8);
+        if (prefetch) {
+            ans_sint_decode_states<dec_entry_sint_small, true>(
+                ans_frame, states, in_u8, out_u32, to_decode);
+        } else {
+            ans_sint_decode_states<dec_entry_sint_small, false>(
+                ans_frame, states, in_u8, out_u32, to_decode);
         }
     } else {
-        while (cur_idx != fast_decode) {
-            out_u32[cur_idx]
-                = ans_frame.decode_sym<dec_entry_sint>(states[0], in_u8);
-            out_u32[cur_idx + 1]
-                = ans_frame.decode_sym<dec_entry_sint>(states[1], in_u8);
-            out_u32[cur_idx + 2]
-                = ans_frame.decode_sym<dec_entry_sint>(states[2], in_u8);
-            out_u32[cur_idx + 3]
-                = ans_frame.decode_sym<dec_entry_sint>(states[3], in_u8);
-            cur_idx += num_states;
-        }
-        while (cur_idx != to_decode) {
-            out_u32[cur_idx++] = ans_frame.decode_sym<dec_entry_sint>(
-                states[num_states - 1], in_u8);
+        if (prefetch) {
+            ans_sint_decode_states<dec_entry_sint, true>(
+                ans_frame, states, in_u8, out_u32, to_decode);
+        } else {
+            ans_sint_decode_states<dec_entry_sint, false>(
+                ans_frame, states, in_u8, out_u32, to_decode);
         }
     }
-}
\ No newline at end of file
+}
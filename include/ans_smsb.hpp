@@ -18,7 +18,8 @@
 #pragma once
 
 // code used to create Fig. 12 in the paper which shows trade-offs for different
-// approximation ratios
+// approximation ratios. the ratio is a runtime argument of the encoder and is
+// stored vbyte coded in front of the prelude
 
 #include "ans_util.hpp"
 #include "interp.hpp"
@@ -75,10 +76,12 @@ uint16_t ans_smsb_mapping_and_exceptions(uint32_t x, uint8_t*& except_out)
     return (x >> 24) + 768;
 }
 
-template <uint32_t H_approx> struct ans_smsb_encode {
-    static ans_smsb_encode create(const uint32_t* in_u32, size_t n)
+struct ans_smsb_encode {
+    static ans_smsb_encode create(
+        const uint32_t* in_u32, size_t n, uint32_t H_approx)
     {
         ans_smsb_encode model;
+        model.H_approx = H_approx;
         std::vector<uint64_t> freqs(smsb_constants::MAX_SIGMA, 0);
         uint32_t max_sym = 0;
         for (size_t i = 0; i < n; i++) {
@@ -102,9 +105,13 @@ template <uint32_t H_approx> struct ans_smsb_encode {
         return model;
     }
 
+    // the approximation ratio in front of the prelude
     size_t serialize(uint8_t*& out_u8)
     {
-        return ans_serialize_interp(nfreqs, frame_size, out_u8);
+        auto start = out_u8;
+        vbyte_encode_u32(out_u8, H_approx);
+        ans_serialize_interp(nfreqs, frame_size, out_u8);
+        return out_u8 - start;
     }
 
     void encode_symbol(uint64_t& state, uint32_t sym, uint8_t*& out_u8)
@@ -128,6 +135,7 @@ template <uint32_t H_approx> struct ans_smsb_encode {
         out_u8 += sizeof(uint64_t);
     }
 
+    uint32_t H_approx;
     std::vector<uint32_t> nfreqs;
     std::vector<enc_entry_smsb> table;
     uint64_t frame_size;
@@ -182,6 +190,7 @@ struct ans_smsb_decode {
     static ans_smsb_decode load(const uint8_t* in_u8)
     {
         ans_smsb_decode model;
+        model.H_approx = vbyte_decode_u32(in_u8);
         model.nfreqs = ans_load_interp(in_u8);
         model.frame_size = std::accumulate(
             std::begin(model.nfreqs), std::end(model.nfreqs), 0);
@@ -227,17 +236,17 @@ struct ans_smsb_decode {
         return decoded_sym;
     }
 
+    uint32_t H_approx;
     std::vector<uint32_t> nfreqs;
     uint64_t frame_size;
     uint64_t frame_mask;
     uint64_t frame_log2;
     uint64_t lower_bound;
-    std::vector<dec_entry_smsb> table;
+    table_vector<dec_entry_smsb> table;
 };
 
-template <uint32_t H_approx>
-size_t ans_smsb_compress(
-    uint8_t* dst, size_t dstCapacity, const uint32_t* src, size_t srcSize)
+size_t ans_smsb_compress(uint8_t* dst, size_t dstCapacity, const uint32_t* src,
+    size_t srcSize, uint32_t H_approx)
 {
     const uint32_t num_states = 4;
 #ifdef RECORD_STATS
@@ -245,7 +254,7 @@ size_t ans_smsb_compress(
 #endif
 
     auto in_u32 = reinterpret_cast<const uint32_t*>(src);
-    auto ans_frame = ans_smsb_encode<H_approx>::create(in_u32, srcSize);
+    auto ans_frame = ans_smsb_encode::create(in_u32, srcSize, H_approx);
     uint8_t* out_u8 = reinterpret_cast<uint8_t*>(dst);
 
     // serialize model
@@ -0,0 +1,265 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* streamvbyte with separately modelled control and data bytes.
+
+   streamvbyte writes one control byte holding the 2-bit lengths of four
+   values, followed by the data bytes of all values. Coding the whole
+   output with one byte model mixes the two very different distributions,
+   here the control bytes and the data bytes get an ans_byte model each.
+   With t_split_data the data bytes are further split by their position
+   within the integer, byte 0 of every value in the first stream, byte 1
+   of the values with at least two bytes in the second and so on, so the
+   low and high bytes are modelled separately. Streams that ans_byte does
+   not make smaller are stored raw.
+
+   The decoder works through the values in blocks of BLOCK_SIZE. The
+   control and data bytes of a block are decoded into the caller supplied
+   buffer, for the unsplit variant in the streamvbyte layout which is
+   passed to streamvbyte_decode, for the split variant as one run per
+   data stream from which the values are reassembled. The ANS states of
+   every stream carry over from one block to the next, so the stream
+   format does not depend on the block size.
+
+   Layout: (uint32 raw size, uint32 stored size) of the control stream and
+   of each data stream, the streams.
+*/
+
+#include "ans_byte.hpp"
+#include "streamvbyte.h"
+
+namespace svb_constants {
+const uint32_t MAX_BYTES = 4;
+// values per decoded block, a multiple of the four values of a control byte
+const uint32_t BLOCK_SIZE = 2048;
+}
+
+// 2-bit length code of x as used by streamvbyte
+inline uint32_t ans_svb_code(uint32_t x)
+{
+    return x < (1U << 8) ? 0 : x < (1U << 16) ? 1 : x < (1U << 24) ? 2 : 3;
+}
+
+// compresses one stream straight into the output, kept raw if ans_byte
+// does not make it smaller
+size_t ans_svb_store(uint8_t*& out_u8, uint32_t* sizes, const uint8_t* in_u8,
+    size_t raw_bytes, size_t out_capacity)
+{
+    size_t stored_bytes = raw_bytes;
+    if (raw_bytes != 0) {
+        stored_bytes
+            = ans_byte_compress(out_u8, out_capacity, in_u8, raw_bytes);
+    }
+    if (stored_bytes >= raw_bytes) {
+        stored_bytes = raw_bytes;
+        memcpy(out_u8, in_u8, raw_bytes);
+    }
+    sizes[0] = raw_bytes;
+    sizes[1] = stored_bytes;
+    out_u8 += stored_bytes;
+    return stored_bytes;
+}
+
+// a stream written by ans_svb_store, decoded in consecutive pieces. The
+// symbols are decoded in the order of ans_byte_decompress: position i
+// with state i % 4 and the to_decode % 4 symbols at the end with state 3
+struct ans_svb_stream {
+    static ans_svb_stream load(const uint8_t*& in_u8, const uint32_t* sizes)
+    {
+        ans_svb_stream stream;
+        stream.raw = sizes[1] >= sizes[0];
+        stream.in_u8 = in_u8;
+        in_u8 += sizes[1];
+        if (!stream.raw) {
+            stream.ans_frame = ans_byte_decode::load(stream.in_u8);
+            stream.in_u8 = in_u8;
+            for (auto& state : stream.states)
+                state = stream.ans_frame.init_state(stream.in_u8);
+        }
+        stream.fast_decode = sizes[0] - sizes[0] % 4;
+        return stream;
+    }
+
+    uint8_t decode_sym()
+    {
+        auto& state = cur_idx < fast_decode ? states[cur_idx % 4] : states[3];
+        cur_idx++;
+        return ans_frame.decode_sym(state, in_u8);
+    }
+
+    void decode(uint8_t* out_u8, size_t n)
+    {
+        if (raw) {
+            memcpy(out_u8, in_u8, n);
+            in_u8 += n;
+            return;
+        }
+        size_t i = 0;
+        while (i != n && cur_idx % 4 != 0)
+            out_u8[i++] = decode_sym();
+        size_t fast = cur_idx < fast_decode ? fast_decode - cur_idx : 0;
+        fast = std::min(fast, n - i);
+        fast -= fast % 4;
+        // the four symbols are stored as one uint32, byte stores could
+        // alias the members and force them to be reloaded for every symbol
+        auto state_d = states[0], state_c = states[1], state_b = states[2],
+             state_a = states[3];
+        for (size_t end = i + fast; i != end; i += 4) {
+            uint32_t a = ans_frame.decode_sym(state_d, in_u8);
+            uint32_t b = ans_frame.decode_sym(state_c, in_u8);
+            uint32_t c = ans_frame.decode_sym(state_b, in_u8);
+            uint32_t d = ans_frame.decode_sym(state_a, in_u8);
+            auto out_u32 = reinterpret_cast<uint32_t*>(out_u8 + i);
+            *out_u32 = a | (b << 8) | (c << 16) | (d << 24);
+        }
+        states = { state_d, state_c, state_b, state_a };
+        cur_idx += fast;
+        while (i != n)
+            out_u8[i++] = decode_sym();
+    }
+
+    bool raw;
+    const uint8_t* in_u8;
+    ans_byte_decode ans_frame;
+    std::array<uint64_t, 4> states;
+    size_t cur_idx = 0;
+    size_t fast_decode;
+};
+
+template <bool t_split_data>
+size_t ans_svb_compress(uint8_t* dst, size_t dstCapacity, const uint32_t* src,
+    size_t srcSize, uint8_t* buf)
+{
+    const uint32_t num_streams
+        = t_split_data ? 1 + svb_constants::MAX_BYTES : 2;
+    uint8_t* out_u8 = dst;
+    auto sizes = reinterpret_cast<uint32_t*>(out_u8);
+    out_u8 += 2 * num_streams * sizeof(uint32_t);
+    auto capacity = [&] { return dstCapacity - (out_u8 - dst); };
+
+    size_t control_bytes = (srcSize + 3) / 4;
+    if (!t_split_data) {
+        size_t vbyte_bytes = streamvbyte_encode(src, srcSize, buf);
+        ans_svb_store(out_u8, sizes, buf, control_bytes, capacity());
+        ans_svb_store(out_u8, sizes + 2, buf + control_bytes,
+            vbyte_bytes - control_bytes, capacity());
+        return out_u8 - dst;
+    }
+
+    // the control bytes as in streamvbyte, the data bytes by position
+    std::vector<uint8_t> control(control_bytes, 0);
+    std::vector<std::vector<uint8_t>> data(svb_constants::MAX_BYTES);
+    for (size_t i = 0; i < srcSize; i++) {
+        uint32_t code = ans_svb_code(src[i]);
+        control[i / 4] |= code << (2 * (i % 4));
+        for (uint32_t j = 0; j <= code; j++)
+            data[j].push_back(src[i] >> (8 * j));
+    }
+    ans_svb_store(out_u8, sizes, control.data(), control_bytes, capacity());
+    for (uint32_t j = 0; j < svb_constants::MAX_BYTES; j++) {
+        ans_svb_store(out_u8, sizes + 2 * (j + 1), data[j].data(),
+            data[j].size(), capacity());
+    }
+    return out_u8 - dst;
+}
+
+// the number of values with at least j + 1 bytes among the n values with
+// control bytes control_u8. the unused codes of the last byte are 0. code
+// c >= 1 if either bit is set, c >= 2 if the high bit is set and c == 3 if
+// both are set, counted for 32 codes at a time
+std::array<size_t, svb_constants::MAX_BYTES> ans_svb_counts(
+    const uint8_t* control_u8, size_t n)
+{
+    const uint64_t low_bits = 0x5555555555555555ULL;
+    std::array<size_t, svb_constants::MAX_BYTES> counts {};
+    counts[0] = n;
+    auto count = [&](uint64_t codes) {
+        counts[1] += __builtin_popcountll((codes | (codes >> 1)) & low_bits);
+        counts[2] += __builtin_popcountll(codes & ~low_bits);
+        counts[3] += __builtin_popcountll(codes & (codes >> 1) & low_bits);
+    };
+    size_t control_bytes = (n + 3) / 4;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= control_bytes; i += sizeof(uint64_t)) {
+        uint64_t codes;
+        memcpy(&codes, control_u8 + i, sizeof(uint64_t));
+        count(codes);
+    }
+    uint64_t codes = 0;
+    memcpy(&codes, control_u8 + i, control_bytes - i);
+    count(codes);
+    return counts;
+}
+
+template <bool t_split_data>
+void ans_svb_decompress(uint32_t* dst, size_t to_decode, const uint8_t* cSrc,
+    size_t cSrcSize, uint8_t* buf)
+{
+    const uint32_t num_streams
+        = t_split_data ? 1 + svb_constants::MAX_BYTES : 2;
+    uint32_t sizes[2 * num_streams];
+    memcpy(sizes, cSrc, sizeof(sizes));
+    const uint8_t* in_u8 = cSrc + sizeof(sizes);
+    std::array<ans_svb_stream, 1 + svb_constants::MAX_BYTES> streams;
+    for (uint32_t s = 0; s < num_streams; s++)
+        streams[s] = ans_svb_stream::load(in_u8, sizes + 2 * s);
+
+    for (size_t start = 0; start < to_decode;
+         start += svb_constants::BLOCK_SIZE) {
+        size_t block
+            = std::min<size_t>(svb_constants::BLOCK_SIZE, to_decode - start);
+        size_t control_bytes = (block + 3) / 4;
+        streams[0].decode(buf, control_bytes);
+        auto counts = ans_svb_counts(buf, block);
+        if (!t_split_data) {
+            size_t data_bytes = counts[0] + counts[1] + counts[2] + counts[3];
+            streams[1].decode(buf + control_bytes, data_bytes);
+            streamvbyte_decode(buf, dst + start, block);
+            continue;
+        }
+
+        // the data bytes of the block, one run per stream
+        std::array<uint8_t*, svb_constants::MAX_BYTES> runs;
+        runs[0] = buf + control_bytes;
+        for (uint32_t j = 0; j < svb_constants::MAX_BYTES; j++) {
+            if (j != 0)
+                runs[j] = runs[j - 1] + counts[j - 1];
+            streams[1 + j].decode(runs[j], counts[j]);
+        }
+        const uint8_t* control = buf;
+        const uint8_t* byte0 = runs[0];
+        const uint8_t* byte1 = runs[1];
+        const uint8_t* byte2 = runs[2];
+        const uint8_t* byte3 = runs[3];
+        uint32_t* out_u32 = dst + start;
+        for (size_t i = 0; i < block; i++) {
+            uint32_t code = (control[i / 4] >> (2 * (i % 4))) & 3;
+            uint32_t x = *byte0++;
+            if (code != 0) {
+                x |= uint32_t(*byte1++) << 8;
+                if (code != 1) {
+                    x |= uint32_t(*byte2++) << 16;
+                    if (code != 2)
+                        x |= uint32_t(*byte3++) << 24;
+                }
+            }
+            out_u32[i] = x;
+        }
+    }
+}
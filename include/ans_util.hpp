@@ -17,6 +17,11 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <sys/mman.h>
+#include <type_traits>
+
 #include "interp.hpp"
 #include "vbyte.hpp"
 
@@ -146,7 +151,8 @@ std::vector<uint32_t> adjust_freqs(const std::vector<uint64_t>& freqs,
         // std::cout << "sigma=" << sigma << " m=" << freq_sum << " M=" <<
         // target_frame_size << " H=" << H << " XH=" << XH << " max_freq= " <<
         // max_norm_freq << std::endl;
-        if (XH < threshold) {
+        // <= so a single symbol (H = XH = 0) stops at the smallest frame
+        if (XH <= threshold) {
             break;
         }
         target_frame_size *= 2;
@@ -155,3 +161,270 @@ std::vector<uint32_t> adjust_freqs(const std::vector<uint64_t>& freqs,
 
     return scaled;
 }
+
+// scale frequencies to the power of two frame with the smallest encoded
+// size, stream (by the cross entropy) plus prelude, among the frames whose
+// decode table fits table_budget bytes. entries take entry_bytes_u16 if
+// all frequencies fit a uint16 and entry_bytes_u32 otherwise, 0 if the
+// decoder requires uint16 frequencies. a larger frame has to save 1/1000
+// of the size to be picked, so the budget is not spent on a larger table
+// that hardly compresses better. a frame smaller than the alphabet is not
+// possible, so if even the smallest frame does not fit it is used anyway
+std::vector<uint32_t> adjust_freqs_budget(const std::vector<uint64_t>& freqs,
+    uint32_t largest_sym, size_t table_budget, size_t entry_bytes_u16,
+    size_t entry_bytes_u32)
+{
+    size_t sigma = 0;
+    size_t freq_sum = 0;
+    for (size_t i = 0; i < freqs.size(); i++) {
+        freq_sum += freqs[i];
+        sigma += (freqs[i] != 0);
+    }
+    // sigma - 1 wraps around for empty input
+    size_t min_frame_size = sigma <= 1 ? 1 : next_power_of_two(sigma - 1);
+    size_t max_frame_size = std::max(min_frame_size,
+        next_power_of_two(table_budget / entry_bytes_u16) / 2);
+
+    std::vector<std::pair<uint64_t, uint32_t>> sorted_freqs;
+    for (size_t i = 0; i < freqs.size(); i++) {
+        if ((freqs[i] != 0))
+            sorted_freqs.emplace_back(freqs[i], i);
+    }
+    std::sort(sorted_freqs.begin(), sorted_freqs.end());
+    std::vector<uint32_t> mapping(sigma);
+    for (size_t i = 0; i < sorted_freqs.size(); i++)
+        mapping[i] = sorted_freqs[i].second;
+
+    std::vector<uint32_t> scaled(largest_sym + 1, 0);
+    std::vector<uint32_t> best;
+    double best_bits = std::numeric_limits<double>::max();
+    // interp needs at most 33 bits per value for universes below 2^33
+    std::vector<uint32_t> prelude(2 * (largest_sym + 1) + 16);
+    uint32_t u16_limit = std::numeric_limits<uint16_t>::max();
+    for (size_t frame_size = min_frame_size; frame_size <= max_frame_size;
+         frame_size *= 2) {
+        if (scale_freqs(scaled, freqs, mapping, frame_size, sigma, freq_sum))
+            continue;
+        auto max_norm_freq = *std::max_element(scaled.begin(), scaled.end());
+        if (max_norm_freq >= u16_limit) {
+            if (entry_bytes_u32 == 0)
+                break;
+            if (frame_size != min_frame_size
+                && frame_size * entry_bytes_u32 > table_budget)
+                break;
+        }
+        auto prelude_u8 = reinterpret_cast<uint8_t*>(prelude.data());
+        double bits = 8.0 * ans_serialize_interp(scaled, frame_size, prelude_u8)
+            + double(freq_sum) * cross_entropy(freqs, scaled);
+        if (bits < best_bits * 0.999) {
+            best_bits = bits;
+            best = scaled;
+        }
+    }
+    // scaling failed on all frames that fit
+    if (best.empty())
+        return adjust_freqs(freqs, largest_sym, entry_bytes_u32 == 0);
+    return best;
+}
+
+// decode table budget of the ANS codec wrappers in methods.hpp, a runtime
+// option (benchmark --table-budget). 0 picks the frame with adjust_freqs
+struct ans_options {
+    inline static size_t table_budget = 0;
+    // approximation ratio of ANSsint/ANSsmsb (benchmark --approx), 0
+    // searches it with search_H_approx under decode_target_ns
+    inline static uint32_t H_approx = 1;
+    inline static double decode_target_ns = 0;
+
+    // appended to the codec names so runs with a budget are told apart
+    static std::string name_suffix()
+    {
+        if (table_budget == 0)
+            return "";
+        return "-tb" + std::to_string(table_budget >> 10) + "KiB";
+    }
+};
+
+// the approximation ratios of Fig. 12, tried by search_H_approx
+const std::array<uint32_t, 8> H_APPROX_RATIOS
+    = { 1, 5, 10, 20, 40, 80, 160, 320 };
+
+// the ratio of H_APPROX_RATIOS with the smallest output among those whose
+// decode of in_u32 takes at most target_ns per int, the fastest ratio if
+// none does. every ratio is encoded and its decode timed (best of 3) on
+// this machine. larger ratios give smaller frames, a ratio with the same
+// output size as the one before it picked the same frame and is skipped
+template <class t_compress, class t_decompress>
+uint32_t search_H_approx(const uint32_t* in_u32, size_t n, double target_ns,
+    t_compress compress, t_decompress decompress)
+{
+    std::vector<uint8_t> encoded(n * 8 + 1024);
+    std::vector<uint32_t> decoded(n);
+    uint32_t best = H_APPROX_RATIOS[0];
+    size_t best_bytes = std::numeric_limits<size_t>::max();
+    uint32_t fastest = H_APPROX_RATIOS[0];
+    double fastest_ns = std::numeric_limits<double>::max();
+    size_t prev_bytes = 0;
+    for (auto H_approx : H_APPROX_RATIOS) {
+        size_t bytes = compress(
+            encoded.data(), encoded.size(), in_u32, n, H_approx);
+        if (bytes == prev_bytes)
+            continue;
+        prev_bytes = bytes;
+        double ns = std::numeric_limits<double>::max();
+        for (int run = 0; run < 3; run++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            decompress(decoded.data(), n, encoded.data(), bytes);
+            auto stop = std::chrono::high_resolution_clock::now();
+            ns = std::min(ns, double((stop - start).count()) / n);
+        }
+        if (ns < fastest_ns) {
+            fastest_ns = ns;
+            fastest = H_approx;
+        }
+        if (ns <= target_ns && bytes < best_bytes) {
+            best_bytes = bytes;
+            best = H_approx;
+        }
+    }
+    if (best_bytes == std::numeric_limits<size_t>::max())
+        return fastest;
+    return best;
+}
+
+// adjust_freqs, or adjust_freqs_budget if a table budget is given. the
+// entry sizes are the ones of adjust_freqs_budget, entry_bytes_u32 == 0
+// requires uint16 frequencies
+std::vector<uint32_t> normalize_freqs(const std::vector<uint64_t>& freqs,
+    uint32_t largest_sym, size_t table_budget, size_t entry_bytes_u16,
+    size_t entry_bytes_u32 = 0)
+{
+    if (table_budget == 0)
+        return adjust_freqs(freqs, largest_sym, entry_bytes_u32 == 0);
+    return adjust_freqs_budget(
+        freqs, largest_sym, table_budget, entry_bytes_u16, entry_bytes_u32);
+}
+
+// decode tables larger than this miss the L1 and often the L2 cache on
+// most lookups and are decoded with software prefetching
+const size_t PREFETCH_TABLE_BYTES = size_t(256) << 10;
+
+enum table_prefetch { PREFETCH_AUTO, PREFETCH_ON, PREFETCH_OFF };
+
+inline bool use_prefetch(table_prefetch mode, size_t table_bytes)
+{
+    if (mode == PREFETCH_AUTO)
+        return table_bytes > PREFETCH_TABLE_BYTES;
+    return mode == PREFETCH_ON;
+}
+
+// template argument of the decode loops for a frame size only known at
+// runtime, taken from the frame_log2 member of the model
+const uint32_t FRAME_LOG2_ANY = 0;
+
+// calls fn with std::integral_constant<uint32_t, frame_log2> for the frame
+// sizes 2^10 to 2^20, for which fn instantiates a decode loop with constant
+// shifts, masks and lower bound, and with FRAME_LOG2_ANY for all others
+template <class t_fn> void dispatch_frame_log2(uint64_t frame_log2, t_fn&& fn)
+{
+    switch (frame_log2) {
+    case 10:
+        return fn(std::integral_constant<uint32_t, 10>());
+    case 11:
+        return fn(std::integral_constant<uint32_t, 11>());
+    case 12:
+        return fn(std::integral_constant<uint32_t, 12>());
+    case 13:
+        return fn(std::integral_constant<uint32_t, 13>());
+    case 14:
+        return fn(std::integral_constant<uint32_t, 14>());
+    case 15:
+        return fn(std::integral_constant<uint32_t, 15>());
+    case 16:
+        return fn(std::integral_constant<uint32_t, 16>());
+    case 17:
+        return fn(std::integral_constant<uint32_t, 17>());
+    case 18:
+        return fn(std::integral_constant<uint32_t, 18>());
+    case 19:
+        return fn(std::integral_constant<uint32_t, 19>());
+    case 20:
+        return fn(std::integral_constant<uint32_t, 20>());
+    default:
+        return fn(std::integral_constant<uint32_t, FRAME_LOG2_ANY>());
+    }
+}
+
+const size_t CACHE_LINE_BYTES = 64;
+const size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+// decode tables of at least this size are backed by 2 MiB pages, smaller
+// ones are covered by the second level TLB with 4 KiB pages
+const size_t HUGE_PAGE_TABLE_BYTES = size_t(1) << 20;
+
+// allocator of the decode tables. tables are cache line aligned, so no
+// entry straddles two lines, and large tables are mapped with 2 MiB pages
+// so random lookups do not miss the TLB on every access: explicit huge
+// pages (MAP_HUGETLB) if the system has reserved some, otherwise a 2 MiB
+// aligned mapping marked for transparent huge pages (MADV_HUGEPAGE)
+template <class T> struct table_allocator {
+    using value_type = T;
+
+    table_allocator() = default;
+    template <class U> table_allocator(const table_allocator<U>&) { }
+
+    static size_t mapped_bytes(size_t n)
+    {
+        return (n * sizeof(T) + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+    }
+
+    T* allocate(size_t n)
+    {
+        if (n * sizeof(T) < HUGE_PAGE_TABLE_BYTES) {
+            void* ptr = aligned_alloc(CACHE_LINE_BYTES, n * sizeof(T));
+            if (ptr == nullptr)
+                throw std::bad_alloc();
+            return static_cast<T*>(ptr);
+        }
+        size_t bytes = mapped_bytes(n);
+        void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED)
+            return static_cast<T*>(ptr);
+        // map one huge page more and unmap the unaligned ends
+        size_t span = bytes + HUGE_PAGE_BYTES;
+        ptr = mmap(nullptr, span, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+        auto raw = static_cast<uint8_t*>(ptr);
+        auto start = reinterpret_cast<uint8_t*>(
+            (reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE_BYTES - 1)
+            & ~(HUGE_PAGE_BYTES - 1));
+        if (start != raw)
+            munmap(raw, start - raw);
+        if (start + bytes != raw + span)
+            munmap(start + bytes, raw + span - (start + bytes));
+        madvise(start, bytes, MADV_HUGEPAGE);
+        return reinterpret_cast<T*>(start);
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        if (n * sizeof(T) < HUGE_PAGE_TABLE_BYTES) {
+            aligned_free(ptr);
+        } else {
+            munmap(ptr, mapped_bytes(n));
+        }
+    }
+
+    template <class U> bool operator==(const table_allocator<U>&) const
+    {
+        return true;
+    }
+    template <class U> bool operator!=(const table_allocator<U>&) const
+    {
+        return false;
+    }
+};
+
+template <class T> using table_vector = std::vector<T, table_allocator<T>>;
@@ -163,6 +163,9 @@ size_t interp_decompress(uint32_t* obuff, /* output buffer */
 #define MINR ((1LL << (BBITS - 15)))
 #define TBTS 31 /* at this stage, cannot be larger than 31 because of F */
 #define PREL_RECURSE 1000
+#define LOOKUP_MIN_SYMS 256
+#define LOOKUP_MIN_BITS 8
+#define LOOKUP_MAX_BITS 18 /* 1 MiB of index at most */
 
 /* count through the input array, building a resizing array containing
    symbol frequency counts, including zero for symbols that don't appear
@@ -373,14 +376,52 @@ size_t arith_compress(uint8_t* obuff, /* output buffer */
     return op;
 }
 
+/* build a bucketed index over the cumulative array F, using the top
+   lbits bits of a target to select a bucket; entry b holds the first
+   symbol whose range covers the first target of bucket b, so the symbol
+   for any target in bucket b lies in [index[b], index[b+1]]
+*/
+std::vector<uint32_t> build_lookup(
+    const std::vector<uint32_t>& F, size_t maxv, uint32_t lbits)
+{
+    uint32_t shift = TBTS - lbits;
+    std::vector<uint32_t> index((1ULL << lbits) + 1);
+    uint32_t v = 1;
+    for (uint64_t b = 0; b < (1ULL << lbits); b++) {
+        uint64_t first_target = b << shift;
+        while (F[v] <= first_target) {
+            v++;
+        }
+        index[b] = v;
+    }
+    index[1ULL << lbits] = maxv;
+    return index;
+}
+
+/* pick the number of target bits used to index the lookup table, aiming
+   for a few buckets per distinct symbol without the table spilling out
+   of the cache
+*/
+uint32_t lookup_bits(size_t nunq)
+{
+    uint32_t lbits = 64 - __builtin_clzll(nunq | 1) + 2;
+    if (lbits < LOOKUP_MIN_BITS)
+        lbits = LOOKUP_MIN_BITS;
+    if (lbits > LOOKUP_MAX_BITS)
+        lbits = LOOKUP_MAX_BITS;
+    return lbits;
+}
+
 /* decode the supplied array of bytes and regenerate the original array
-   of strictly positive integers
+   of strictly positive integers; if use_lookup is set, a bucketed index
+   over F narrows the symbol search to a few entries of F
 */
 size_t arith_decompress(uint32_t* obuff, /* output buffer */
     size_t osize, /* number symbols to be decoded */
     const uint8_t* ibuff, /* input buffer */
-    size_t isize)
-{ /* size of input buffer */
+    size_t isize, /* size of input buffer */
+    bool use_lookup = false)
+{ /* use the lookup index to decode */
 
     int i;
     size_t op, ip = 0;
@@ -419,6 +460,18 @@ size_t arith_decompress(uint32_t* obuff, /* output buffer */
         F[i] = F[i - 1] + F[i];
     }
 
+    /* the lookup index is keyed on the top bits of target. on small
+       alphabets the binary search branches are well predicted and win,
+       so only build the index when there are enough distinct symbols */
+    std::vector<uint32_t> index;
+    uint32_t lshift = 0;
+    use_lookup = use_lookup && nunq >= LOOKUP_MIN_SYMS;
+    if (use_lookup) {
+        uint32_t lbits = lookup_bits(nunq);
+        lshift = TBTS - lbits;
+        index = build_lookup(F, maxv, lbits);
+    }
+
     /* load up D */
     D = 0;
     for (i = 0; i < BBYTES; i++) {
@@ -436,8 +489,21 @@ size_t arith_decompress(uint32_t* obuff, /* output buffer */
                    range, and adjust downward if required */
         if (target >= total)
             target = total - 1;
-        /* binary search in F for target is a little faster */
-        {
+        if (use_lookup) {
+            /* bucket holds only a few candidates, binary search those */
+            uint32_t b = target >> lshift;
+            uint32_t lo = index[b], hi = index[b + 1];
+            while (lo < hi) {
+                uint32_t mid = (lo + hi) >> 1;
+                if (F[mid] > target) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            v = lo;
+        } else {
+            /* binary search in F for target is a little faster */
             int lo = 0, hi = maxv;
             /* elements F[lo..hi] inclusive being considered */
             while (lo < hi) {
@@ -452,9 +518,6 @@ size_t arith_decompress(uint32_t* obuff, /* output buffer */
             }
         }
 
-        /* (could also take leading bits of target to index a table
-                   and accelerate the search, leave that for another day)
-                */
         obuff[op] = v - 1;
 
         /* adjust, tracing the encoder, with D=V-L throughout */
@@ -0,0 +1,170 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* One-pass adaptive version of the arith.hpp range coder.
+
+   There is no prelude: every value is split by the msb mapping of
+   ans_msb.hpp into one of 1024 buckets plus up to three exception bytes.
+   The bucket is coded with adaptive counts kept in a Fenwick tree, so both
+   the cumulative count and the inverse search cost O(log sigma) per symbol,
+   and the counts are halved once their total reaches MAX_TOTAL so the model
+   follows local statistics. Exception bytes are coded uniformly through the
+   same coder. Output is produced while the input is being read, so the
+   first bytes are available without a counting pass over the whole list.
+*/
+
+#include "ans_msb.hpp"
+#include "arith_multi.hpp"
+
+namespace adaptive_constants {
+const uint32_t SIGMA = 1024;
+const uint32_t INCREMENT = 24;
+const uint32_t MAX_TOTAL = 1 << 16;
+}
+
+struct arith_adaptive_model {
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> tree;
+    uint32_t total;
+
+    arith_adaptive_model()
+        : counts(adaptive_constants::SIGMA, 1)
+    {
+        rebuild();
+    }
+
+    /* linear time construction of the tree from the counts */
+    void rebuild()
+    {
+        const uint32_t n = adaptive_constants::SIGMA;
+        tree.assign(n + 1, 0);
+        total = 0;
+        for (uint32_t i = 1; i <= n; i++) {
+            tree[i] += counts[i - 1];
+            total += counts[i - 1];
+            uint32_t j = i + (i & -i);
+            if (j <= n)
+                tree[j] += tree[i];
+        }
+    }
+
+    /* sum of the counts of all symbols smaller than sym */
+    uint32_t cumulative(uint32_t sym) const
+    {
+        uint32_t sum = 0;
+        for (uint32_t i = sym; i > 0; i -= (i & -i)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+    /* largest sym with cumulative(sym) <= target, *low is set to that sum */
+    uint32_t find(uint32_t target, uint32_t* low) const
+    {
+        uint32_t pos = 0, sum = 0;
+        for (uint32_t step = adaptive_constants::SIGMA; step; step >>= 1) {
+            uint32_t next = pos + step;
+            if (next <= adaptive_constants::SIGMA
+                && sum + tree[next] <= target) {
+                pos = next;
+                sum += tree[next];
+            }
+        }
+        *low = sum;
+        return pos;
+    }
+
+    void update(uint32_t sym)
+    {
+        const uint32_t inc = adaptive_constants::INCREMENT;
+        counts[sym] += inc;
+        total += inc;
+        if (total >= adaptive_constants::MAX_TOTAL) {
+            /* halve, keeping every symbol codable */
+            for (auto& c : counts) {
+                c = (c + 1) >> 1;
+            }
+            rebuild();
+            return;
+        }
+        for (uint32_t i = sym + 1; i <= adaptive_constants::SIGMA;
+             i += (i & -i)) {
+            tree[i] += inc;
+        }
+    }
+};
+
+size_t arith_adaptive_compress(uint8_t* obuff, /* output buffer */
+    size_t osize, /* output buffer size */
+    const uint32_t* ibuff, /* input buffer */
+    size_t isize)
+{ /* input buffer size */
+    arith_adaptive_model model;
+    arith_multi_encoder coder;
+    coder.out = obuff;
+
+    uint8_t except[4];
+    for (size_t i = 0; i < isize; i++) {
+        uint8_t* except_out = except;
+        uint32_t sym = ans_msb_mapping_and_exceptions(ibuff[i], except_out);
+        uint32_t low = model.cumulative(sym);
+        coder.encode_scaled(low, low + model.counts[sym], model.total,
+            coder.R / model.total);
+        for (uint8_t* e = except; e != except_out; e++) {
+            coder.encode_scaled(*e, *e + 1, 256, coder.R >> 8);
+        }
+        model.update(sym);
+    }
+    coder.flush();
+    return coder.out - obuff;
+}
+
+size_t arith_adaptive_decompress(uint32_t* obuff, /* output buffer */
+    size_t osize, /* number symbols to be decoded */
+    const uint8_t* ibuff, /* input buffer */
+    size_t isize)
+{ /* size of input buffer */
+    arith_adaptive_model model;
+    arith_multi_decoder coder;
+    coder.init(ibuff, ibuff + isize);
+
+    for (size_t i = 0; i < osize; i++) {
+        uint64_t scale = coder.R / model.total;
+        uint64_t target = coder.D / scale;
+        if (target >= model.total)
+            target = model.total - 1;
+        uint32_t low;
+        uint32_t sym = model.find(target, &low);
+        coder.update(low, low + model.counts[sym], model.total, scale);
+
+        uint32_t value = ans_msb_undo_mapping(sym);
+        uint32_t except_bytes = ans_msb_exception_bytes(sym);
+        for (uint32_t j = 0; j < except_bytes; j++) {
+            scale = coder.R >> 8;
+            uint64_t byte = coder.D / scale;
+            if (byte > 255)
+                byte = 255;
+            coder.update(byte, byte + 1, 256, scale);
+            value += byte << (8 * j);
+        }
+        obuff[i] = value;
+        model.update(sym);
+    }
+    return isize;
+}
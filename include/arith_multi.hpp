@@ -0,0 +1,327 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* Interleaved version of the 56-bit arithmetic coder in arith.hpp.
+
+   num_states independent range coders share the semi-static prelude of
+   arith.hpp; symbol i is coded by state i % num_states and every state
+   writes its own byte stream. The streams are stored back to back, each
+   but the last preceded by its length. As the states do not depend on
+   each other the decoder can overlap their divisions and table lookups,
+   which removes most of the serial dependency of the single coder.
+*/
+
+#include "arith.hpp"
+
+struct arith_multi_encoder {
+    uint64_t L = ZERO;
+    uint64_t R = FULL;
+    uint8_t last_non_ff_byte = 0;
+    uint32_t num_ff_bytes = 0;
+    int first = 1;
+    uint8_t* out;
+
+    void encode(uint64_t low, uint64_t high, uint64_t total)
+    {
+        encode_scaled(low, high, total, R >> TBTS);
+    }
+
+    /* code [low,high) out of total where the caller supplies the
+       scale R/total, so total need not be a power of two */
+    void encode_scaled(
+        uint64_t low, uint64_t high, uint64_t total, uint64_t scale)
+    {
+        L += low * scale;
+        if (high < total) {
+            /* top symbol gets beneit of rounding gaps */
+            R = (high - low) * scale;
+        } else {
+            R = R - low * scale;
+        }
+
+        /* push a carry through the ff bytes and into the pending
+           non-ff byte */
+        if (L > FULL) {
+            last_non_ff_byte += 1;
+            L &= FULL;
+            while (num_ff_bytes > 0) {
+                *out++ = last_non_ff_byte;
+                num_ff_bytes--;
+                last_non_ff_byte = ZERO;
+            }
+        }
+
+        while (R < PART) {
+            uint8_t byte = (L >> (BBITS - 8));
+            if (byte != FULLBYTE) {
+                if (!first) {
+                    *out++ = last_non_ff_byte;
+                }
+                while (num_ff_bytes) {
+                    *out++ = FULLBYTE;
+                    num_ff_bytes--;
+                }
+                last_non_ff_byte = byte;
+                first = 0;
+            } else {
+                num_ff_bytes++;
+            }
+            L <<= 8;
+            L &= FULL;
+            R <<= 8;
+        }
+    }
+
+    void flush()
+    {
+        if (!first) {
+            *out++ = last_non_ff_byte;
+        }
+        while (num_ff_bytes) {
+            *out++ = FULLBYTE;
+            num_ff_bytes--;
+        }
+        for (int i = BBYTES - 1; i >= 0; i--) {
+            *out++ = (L >> ((8 * i))) & FULLBYTE;
+        }
+    }
+};
+
+struct arith_multi_decoder {
+    uint64_t R = FULL;
+    uint64_t D = 0;
+    const uint8_t* in;
+    const uint8_t* end;
+
+    void init(const uint8_t* start, const uint8_t* stop)
+    {
+        in = start;
+        end = stop;
+        for (int i = 0; i < BBYTES; i++) {
+            D <<= 8;
+            D += *in++;
+        }
+    }
+
+    /* adjust, tracing the encoder, with D=V-L throughout */
+    void update(uint64_t low, uint64_t high, uint64_t total, uint64_t scale)
+    {
+        D -= low * scale;
+        if (high < total) {
+            R = (high - low) * scale;
+        } else {
+            R = R - low * scale;
+        }
+        while (R < PART) {
+            if (in >= end) {
+                std::cerr << "I/O error" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            R <<= 8;
+            D <<= 8;
+            D &= FULL;
+            D += *in++;
+        }
+    }
+};
+
+/* cumulative counts plus the bucketed index over them that arith_decompress
+   uses, shared by all decoder states */
+struct arith_multi_model {
+    std::vector<uint32_t> F;
+    std::vector<uint32_t> index;
+    uint64_t maxv;
+    uint64_t total;
+    uint64_t lshift;
+
+    arith_multi_model(
+        std::vector<uint32_t>& cumul, size_t max_v, size_t nunq, uint64_t tot)
+        : F(std::move(cumul))
+        , maxv(max_v)
+        , total(tot)
+    {
+        uint32_t lbits = lookup_bits(nunq);
+        lshift = TBTS - lbits;
+        index = build_lookup(F, maxv, lbits);
+    }
+
+    uint32_t decode_sym(arith_multi_decoder& s)
+    {
+        uint64_t scale = s.R >> TBTS;
+        /* the double division is pipelined unlike the integer one, and
+           is off by at most one */
+        uint64_t target = double(s.D) / double(scale);
+        if (target * scale > s.D) {
+            target--;
+        } else if ((target + 1) * scale <= s.D) {
+            target++;
+        }
+        if (target >= total)
+            target = total - 1;
+        uint64_t b = target >> lshift;
+        uint32_t lo = index[b], hi = index[b + 1];
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) >> 1;
+            if (F[mid] > target) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        s.update(F[lo - 1], F[lo], total, scale);
+        return lo - 1;
+    }
+};
+
+/* count and code the prelude exactly as arith_compress does, leaving F as
+   the cumulative array used for coding */
+size_t arith_multi_encode_prelude(uint8_t* obuff, size_t osize,
+    const uint32_t* ibuff, size_t isize, std::vector<uint32_t>& F,
+    size_t* maxv, uint64_t* total)
+{
+    size_t op = 0, nunq = 0;
+    F = count_freqs(ibuff, isize, maxv);
+    for (size_t i = 0; i <= *maxv; i++) {
+        nunq += (F[i] > 0);
+        F[i]++;
+    }
+    op += byte_encode(obuff + op, osize - op, *maxv, (1LL << 31));
+    op += byte_encode(obuff + op, osize - op, nunq, (1LL << 31));
+    if (nunq < PREL_RECURSE) {
+        op += interp_compress(obuff + op, osize - op, F.data(), *maxv + 1);
+    } else {
+        op += arith_compress(obuff + op, osize - op, F.data(), *maxv + 1);
+    }
+    *total = scale_counts(F, *maxv, 0);
+    F[0] = 0;
+    for (size_t i = 1; i <= *maxv; i++) {
+        F[i] = F[i - 1] + F[i];
+    }
+    return op;
+}
+
+size_t arith_multi_decode_prelude(const uint8_t* ibuff, size_t isize,
+    std::vector<uint32_t>& F, size_t* maxv, size_t* nunq, uint64_t* total)
+{
+    size_t ip = 0;
+    uint64_t tmp;
+    ip += byte_decode(ibuff + ip, isize - ip, (1LL << 31), &tmp);
+    *maxv = tmp;
+    ip += byte_decode(ibuff + ip, isize - ip, (1LL << 31), &tmp);
+    *nunq = tmp;
+    F.assign(*maxv + 1, 0);
+    if (*nunq < PREL_RECURSE) {
+        ip += interp_decompress(F.data(), *maxv + 1, ibuff + ip, isize - ip);
+    } else {
+        ip += arith_decompress(F.data(), *maxv + 1, ibuff + ip, isize - ip);
+    }
+    *total = scale_counts(F, *maxv, 1);
+    F[0] = 0;
+    for (size_t i = 1; i <= *maxv; i++) {
+        F[i] = F[i - 1] + F[i];
+    }
+    return ip;
+}
+
+template <uint32_t num_states>
+size_t arith_multi_compress(uint8_t* obuff, /* output buffer */
+    size_t osize, /* output buffer size */
+    const uint32_t* ibuff, /* input buffer */
+    size_t isize)
+{ /* input buffer size */
+    static_assert(num_states >= 2 && num_states <= 4,
+        "arith_multi supports 2 to 4 states");
+
+    std::vector<uint32_t> F;
+    size_t maxv;
+    uint64_t total;
+    size_t op = arith_multi_encode_prelude(
+        obuff, osize, ibuff, isize, F, &maxv, &total);
+
+    /* a symbol never costs more than TBTS bits */
+    std::array<arith_multi_encoder, num_states> states;
+    std::array<std::vector<uint8_t>, num_states> streams;
+    for (uint32_t j = 0; j < num_states; j++) {
+        streams[j].resize((isize / num_states + 1) * 4 + 2 * BBYTES);
+        states[j].out = streams[j].data();
+    }
+    for (size_t i = 0; i < isize; i++) {
+        uint32_t v = ibuff[i] + 1;
+        states[i % num_states].encode(F[v - 1], F[v], total);
+    }
+
+    /* lengths of all but the last stream, then the streams themselves */
+    for (auto& s : states) {
+        s.flush();
+    }
+    for (uint32_t j = 0; j + 1 < num_states; j++) {
+        size_t len = states[j].out - streams[j].data();
+        op += byte_encode(obuff + op, osize - op, len + 1, (1LL << 32));
+    }
+    for (uint32_t j = 0; j < num_states; j++) {
+        size_t len = states[j].out - streams[j].data();
+        memcpy(obuff + op, streams[j].data(), len);
+        op += len;
+    }
+    return op;
+}
+
+template <uint32_t num_states>
+size_t arith_multi_decompress(uint32_t* obuff, /* output buffer */
+    size_t osize, /* number symbols to be decoded */
+    const uint8_t* ibuff, /* input buffer */
+    size_t isize)
+{ /* size of input buffer */
+    std::vector<uint32_t> F;
+    size_t maxv, nunq;
+    uint64_t total;
+    size_t ip = arith_multi_decode_prelude(
+        ibuff, isize, F, &maxv, &nunq, &total);
+
+    std::array<uint64_t, num_states> lens;
+    uint64_t known_len = 0;
+    for (uint32_t j = 0; j + 1 < num_states; j++) {
+        ip += byte_decode(ibuff + ip, isize - ip, (1LL << 32), &lens[j]);
+        lens[j]--;
+        known_len += lens[j];
+    }
+    lens[num_states - 1] = isize - ip - known_len;
+
+    std::array<arith_multi_decoder, num_states> states;
+    for (uint32_t j = 0; j < num_states; j++) {
+        states[j].init(ibuff + ip, ibuff + ip + lens[j]);
+        ip += lens[j];
+    }
+
+    arith_multi_model model(F, maxv, nunq, total);
+
+    size_t op = 0;
+    size_t fast_decode = osize - (osize % num_states);
+    while (op != fast_decode) {
+        for (uint32_t j = 0; j < num_states; j++) {
+            obuff[op + j] = model.decode_sym(states[j]);
+        }
+        op += num_states;
+    }
+    while (op != osize) {
+        obuff[op] = model.decode_sym(states[op % num_states]);
+        op++;
+    }
+    return isize;
+}
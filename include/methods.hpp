@@ -18,6 +18,7 @@
 #pragma once
 
 #include "arith.hpp"
+#include "arith_multi.hpp"
 #include "compositecodec.h"
 #include "fse.h"
 #include "huf.h"
@@ -27,13 +28,28 @@
 #include "variablebyte.h"
 
 #include "ans_byte.hpp"
+#include "ans_byte_o1.hpp"
+#include "ans_byte_x32.hpp"
 #include "ans_fold.hpp"
 #include "ans_int.hpp"
+#include "ans_int_esc.hpp"
 #include "ans_msb.hpp"
+#include "ans_msb_compact.hpp"
+#include "ans_msb_ex.hpp"
+#include "ans_msb_o1.hpp"
+#include "ans_msb_param.hpp"
+#include "ans_msb_pair.hpp"
+#include "ans_pair.hpp"
+#include "ans_pfor.hpp"
 #include "ans_reorder_fold.hpp"
+#include "ans_reorder_msb.hpp"
 
 #include "ans_sint.hpp"
 #include "ans_smsb.hpp"
+#include "ans_svb.hpp"
+
+#include "arith_adaptive.hpp"
+#include "rle.hpp"
 
 struct vbyte {
     static std::string name() { return "vbyte"; }
@@ -86,6 +102,21 @@ template <uint32_t t_block_size = 128> struct optpfor {
     }
 };
 
+struct optpforANS {
+    static std::string name() { return "OptPForANS"; }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_pfor_compress(out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_pfor_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
 struct streamvbyte {
     static std::string name() { return "streamvbyte"; }
 
@@ -481,13 +512,95 @@ struct vbyteANS {
     }
 };
 
+// vbyteANS and streamvbyteANS with the 32 lane byte coder, the decoder
+// backend is picked at runtime
+template <class t_vbyte> struct vbyteANSx32 {
+    static std::string name() { return t_vbyte::name() + "ANS-x32"; }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        size_t vbyte_bytes
+            = t_vbyte::encode(in_ptr, in_size_u32, buf, out_size_u8);
+        auto out_ptr_u32 = reinterpret_cast<uint32_t*>(out_ptr);
+        *out_ptr_u32 = vbyte_bytes;
+        auto stored_bytes = ans_byte_x32_compress(out_ptr + sizeof(uint32_t),
+            out_size_u8 - sizeof(uint32_t), buf, vbyte_bytes);
+        return stored_bytes + sizeof(uint32_t);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_ptr);
+        size_t vbyte_bytes = *in_ptr_u32;
+        in_ptr += +sizeof(uint32_t);
+        ans_byte_x32_decompress(
+            buf, vbyte_bytes, in_ptr, in_size_u8 - sizeof(uint32_t));
+        t_vbyte::decode(buf, vbyte_bytes, out_ptr, out_size_u32);
+    }
+};
+
+template <uint32_t t_ctx_bits = 1> struct vbyteANS1 {
+    static std::string name()
+    {
+        return "vbyteANS1-c" + std::to_string(1 << t_ctx_bits);
+    }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        size_t vbyte_bytes
+            = vbyte::encode(in_ptr, in_size_u32, buf, out_size_u8);
+        auto out_ptr_u32 = reinterpret_cast<uint32_t*>(out_ptr);
+        *out_ptr_u32 = vbyte_bytes;
+        auto stored_bytes = ans_byte_o1_compress<t_ctx_bits>(
+            out_ptr + sizeof(uint32_t), out_size_u8 - sizeof(uint32_t), buf,
+            vbyte_bytes);
+        return stored_bytes + sizeof(uint32_t);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_ptr);
+        size_t vbyte_bytes = *in_ptr_u32;
+        in_ptr += +sizeof(uint32_t);
+        ans_byte_o1_decompress<t_ctx_bits>(
+            buf, vbyte_bytes, in_ptr, in_size_u8 - sizeof(uint32_t));
+        vbyte::decode(buf, vbyte_bytes, out_ptr, out_size_u32);
+    }
+};
+
+template <bool t_split_data = false> struct streamvbyteANSdual {
+    static std::string name()
+    {
+        return t_split_data ? "streamvbyteANS-split" : "streamvbyteANS-dual";
+    }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_svb_compress<t_split_data>(
+            out_ptr, out_size_u8, in_ptr, in_size_u32, buf);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_svb_decompress<t_split_data>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8, buf);
+    }
+};
+
 struct ANSint {
-    static std::string name() { return std::string("ANS"); }
+    static std::string name()
+    {
+        return std::string("ANS") + ans_options::name_suffix();
+    }
 
     static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
         uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
     {
-        return ans_int_compress(out_ptr, out_size_u8, in_ptr, in_size_u32);
+        return ans_int_compress(out_ptr, out_size_u8, in_ptr, in_size_u32,
+            ans_options::table_budget);
     }
     static void decode(const uint8_t* in_ptr, size_t in_size_u8,
         uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
@@ -496,19 +609,212 @@ struct ANSint {
     }
 };
 
+// ANSint with table prefetching forced on or off instead of chosen by the
+// table size
+template <table_prefetch t_prefetch> struct ANSint_prefetch {
+    static std::string name()
+    {
+        return std::string("ANS-pf-")
+            + (t_prefetch == PREFETCH_ON ? "on" : "off");
+    }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_int_compress(out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_int_decompress<t_prefetch>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+template <uint32_t budget_kib> struct ANSint_esc {
+    static std::string name()
+    {
+        return std::string("ANS-esc-") + std::to_string(budget_kib) + "KiB";
+    }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_int_esc_compress<budget_kib>(
+            out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_int_esc_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
 struct ANSmsb {
-    static std::string name() { return "ANSmsb"; }
+    static std::string name() { return "ANSmsb" + ans_options::name_suffix(); }
 
     static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
         uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
     {
-        return ans_msb_compress(out_ptr, out_size_u8, in_ptr, in_size_u32);
+        return ans_msb_compress(out_ptr, out_size_u8, in_ptr, in_size_u32,
+            ans_options::table_budget);
     }
     static void decode(const uint8_t* in_ptr, size_t in_size_u8,
         uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
     {
         ans_msb_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
     }
+    template <class t_output>
+    static void decode_output(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32)
+    {
+        ans_msb_decompress<t_output>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+struct ANSmsb_compact {
+    static std::string name()
+    {
+        return "ANSmsb-compact" + ans_options::name_suffix();
+    }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_msb_compress(out_ptr, out_size_u8, in_ptr, in_size_u32,
+            ans_options::table_budget, sizeof(dec_entry_msb_compact));
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_msb_compact_decompress(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+    template <class t_output>
+    static void decode_output(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32)
+    {
+        ans_msb_compact_decompress<t_output>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+struct ANSrmsb {
+    static std::string name() { return "ANSrmsb"; }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_reorder_msb_compress(
+            out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_reorder_msb_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+    template <class t_output>
+    static void decode_output(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32)
+    {
+        ans_reorder_msb_decompress<t_output>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+struct ANSmsb_ex {
+    static std::string name() { return "ANSmsb-ex"; }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_msb_ex_compress(out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_msb_ex_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+struct ANSmsb_param {
+    static std::string name() { return "ANSmsb-param"; }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_msb_param_compress(
+            out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_msb_param_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+    template <class t_output>
+    static void decode_output(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32)
+    {
+        ans_msb_param_decompress<t_output>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+struct ANSmsb_pair {
+    static std::string name() { return "ANSmsb-pair"; }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_msb_pair_compress(
+            out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_msb_pair_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+template <uint32_t max_contexts> struct ANSmsb_o1 {
+    static std::string name()
+    {
+        return std::string("ANSmsb-o1-") + std::to_string(max_contexts);
+    }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_msb_o1_compress<max_contexts>(
+            out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_msb_o1_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+template <uint32_t max_off_contexts> struct ANSpair {
+    static std::string name()
+    {
+        if (max_off_contexts == 1)
+            return "ANSpair";
+        return "ANSpair-c" + std::to_string(max_off_contexts);
+    }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return ans_pair_compress<max_off_contexts>(
+            out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_pair_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
 };
 
 struct shuff {
@@ -526,22 +832,31 @@ struct shuff {
     }
 };
 
-template <uint32_t fidelity> struct ANSfold {
+template <uint32_t fidelity, uint32_t radix = 8> struct ANSfold {
     static std::string name()
     {
-        return std::string("ANSfold-") + std::to_string(fidelity);
+        std::string suffix = radix == 8 ? "" : "-r" + std::to_string(radix);
+        return std::string("ANSfold-") + std::to_string(fidelity) + suffix
+            + ans_options::name_suffix();
     }
 
     static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
         uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
     {
-        return ans_fold_compress<fidelity>(
-            out_ptr, out_size_u8, in_ptr, in_size_u32);
+        return ans_fold_compress<fidelity, radix>(out_ptr, out_size_u8,
+            in_ptr, in_size_u32, ans_options::table_budget);
     }
     static void decode(const uint8_t* in_ptr, size_t in_size_u8,
         uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
     {
-        ans_fold_decompress<fidelity>(
+        ans_fold_decompress<fidelity, radix>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+    template <class t_output>
+    static void decode_output(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32)
+    {
+        ans_fold_decompress<fidelity, radix, t_output>(
             out_ptr, out_size_u32, in_ptr, in_size_u8);
     }
 };
@@ -566,6 +881,136 @@ template <uint32_t fidelity> struct ANSrfold {
     }
 };
 
+// zero run length front end over another codec. literals and run lengths
+// are kept in buf and coded as two independent streams. inputs with fewer
+// than half zeros are passed to the codec unchanged
+template <class t_codec> struct RLE {
+    static std::string name() { return "RLE+" + t_codec::name(); }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        auto out_ptr_u32 = reinterpret_cast<uint32_t*>(out_ptr);
+        size_t written = 4 * sizeof(uint32_t);
+        if (2 * rle_count_zeros(in_ptr, in_size_u32) < in_size_u32) {
+            out_ptr_u32[0] = 0;
+            return written
+                + t_codec::encode(in_ptr, in_size_u32, out_ptr + written,
+                    out_size_u8 - written);
+        }
+        auto literals = reinterpret_cast<uint32_t*>(buf);
+        auto runs = literals + in_size_u32;
+        size_t num_literals;
+        size_t trailing_zeros = rle_transform(
+            in_ptr, in_size_u32, literals, runs, &num_literals);
+        out_ptr_u32[0] = 1;
+        out_ptr_u32[1] = num_literals;
+        out_ptr_u32[2] = trailing_zeros;
+        size_t literal_bytes = 0;
+        if (num_literals != 0) {
+            literal_bytes = t_codec::encode(literals, num_literals,
+                out_ptr + written, out_size_u8 - written);
+            written += literal_bytes;
+            written += t_codec::encode(
+                runs, num_literals, out_ptr + written, out_size_u8 - written);
+        }
+        out_ptr_u32[3] = literal_bytes;
+        return written;
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        auto in_ptr_u32 = reinterpret_cast<const uint32_t*>(in_ptr);
+        size_t read = 4 * sizeof(uint32_t);
+        if (in_ptr_u32[0] == 0) {
+            t_codec::decode(
+                in_ptr + read, in_size_u8 - read, out_ptr, out_size_u32);
+            return;
+        }
+        size_t num_literals = in_ptr_u32[1];
+        size_t trailing_zeros = in_ptr_u32[2];
+        size_t literal_bytes = in_ptr_u32[3];
+        auto literals = reinterpret_cast<uint32_t*>(buf);
+        auto runs = literals + out_size_u32;
+        if (num_literals != 0) {
+            t_codec::decode(
+                in_ptr + read, literal_bytes, literals, num_literals);
+            read += literal_bytes;
+            t_codec::decode(
+                in_ptr + read, in_size_u8 - read, runs, num_literals);
+        }
+        rle_expand(literals, runs, num_literals, trailing_zeros, out_ptr,
+            out_size_u32);
+    }
+};
+
+// d-gap front end for non-decreasing lists. the gaps are kept in buf, the
+// prefix sum is computed by the decode loop of t_codec, which has to
+// provide decode_output (ANSmsb, ANSfold). a leading uint32 is 1 if the
+// gaps are coded and 0 if they do not fit t_codec (see transform_fits) and
+// the input is coded unchanged
+template <class t_codec> struct Delta {
+    static std::string name() { return "Delta+" + t_codec::name(); }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        auto gaps = reinterpret_cast<uint32_t*>(buf);
+        delta_encode(in_ptr, in_size_u32, gaps);
+        uint32_t transformed = transform_fits(gaps, in_size_u32);
+        memcpy(out_ptr, &transformed, sizeof(uint32_t));
+        return sizeof(uint32_t)
+            + t_codec::encode(transformed ? gaps : in_ptr, in_size_u32,
+                out_ptr + sizeof(uint32_t), out_size_u8 - sizeof(uint32_t));
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        uint32_t transformed;
+        memcpy(&transformed, in_ptr, sizeof(uint32_t));
+        in_ptr += sizeof(uint32_t);
+        in_size_u8 -= sizeof(uint32_t);
+        if (transformed) {
+            t_codec::template decode_output<delta_output>(
+                in_ptr, in_size_u8, out_ptr, out_size_u32);
+        } else {
+            t_codec::decode(in_ptr, in_size_u8, out_ptr, out_size_u32, buf);
+        }
+    }
+};
+
+// zigzag front end for signed values, undone in the decode loop of t_codec.
+// as Delta, the input is coded unchanged if the mapped values do not fit
+template <class t_codec> struct ZigZag {
+    static std::string name() { return "ZigZag+" + t_codec::name(); }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        auto mapped = reinterpret_cast<uint32_t*>(buf);
+        zigzag_encode(in_ptr, in_size_u32, mapped);
+        uint32_t transformed = transform_fits(mapped, in_size_u32);
+        memcpy(out_ptr, &transformed, sizeof(uint32_t));
+        return sizeof(uint32_t)
+            + t_codec::encode(transformed ? mapped : in_ptr, in_size_u32,
+                out_ptr + sizeof(uint32_t), out_size_u8 - sizeof(uint32_t));
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        uint32_t transformed;
+        memcpy(&transformed, in_ptr, sizeof(uint32_t));
+        in_ptr += sizeof(uint32_t);
+        in_size_u8 -= sizeof(uint32_t);
+        if (transformed) {
+            t_codec::template decode_output<zigzag_output>(
+                in_ptr, in_size_u8, out_ptr, out_size_u32);
+        } else {
+            t_codec::decode(in_ptr, in_size_u8, out_ptr, out_size_u32, buf);
+        }
+    }
+};
+
 struct arith {
     static std::string name() { return std::string("arith"); }
 
@@ -581,36 +1026,114 @@ struct arith {
     }
 };
 
-template <uint32_t H_approx> struct ANSsint {
+struct arith_lookup {
+    static std::string name() { return std::string("arith-lookup"); }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return arith_compress(out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        arith_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8, true);
+    }
+};
+
+template <uint32_t num_states> struct arith_multi {
     static std::string name()
     {
-        return std::string("ANSsint-") + std::to_string(H_approx);
+        return std::string("arith-multi-") + std::to_string(num_states);
     }
 
     static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
         uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
     {
-        return ans_sint_compress<H_approx>(
+        return arith_multi_compress<num_states>(
+            out_ptr, out_size_u8, in_ptr, in_size_u32);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        arith_multi_decompress<num_states>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+struct arith_adaptive {
+    static std::string name() { return std::string("arith-adaptive"); }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        return arith_adaptive_compress(
             out_ptr, out_size_u8, in_ptr, in_size_u32);
     }
     static void decode(const uint8_t* in_ptr, size_t in_size_u8,
         uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
     {
-        ans_sint_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
+        arith_adaptive_decompress(out_ptr, out_size_u32, in_ptr, in_size_u8);
     }
 };
 
-template <uint32_t H_approx> struct ANSsmsb {
+// the approximation ratio of ANSsint and ANSsmsb, searched if
+// ans_options::H_approx is 0
+template <class t_compress, class t_decompress>
+uint32_t ans_options_H_approx(const uint32_t* in_ptr, size_t in_size_u32,
+    t_compress compress, t_decompress decompress)
+{
+    if (ans_options::H_approx != 0)
+        return ans_options::H_approx;
+    return search_H_approx(in_ptr, in_size_u32,
+        ans_options::decode_target_ns, compress, decompress);
+}
+
+inline std::string ans_options_H_approx_name()
+{
+    if (ans_options::H_approx == 0)
+        return "auto";
+    return std::to_string(ans_options::H_approx);
+}
+
+template <table_prefetch t_prefetch = PREFETCH_AUTO> struct ANSsint {
     static std::string name()
     {
-        return std::string("ANSsmsb-") + std::to_string(H_approx);
+        std::string suffix = t_prefetch == PREFETCH_AUTO ? ""
+            : t_prefetch == PREFETCH_ON                  ? "-pf-on"
+                                                         : "-pf-off";
+        return std::string("ANSsint-") + ans_options_H_approx_name() + suffix;
     }
 
     static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
         uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
     {
-        return ans_smsb_compress<H_approx>(
-            out_ptr, out_size_u8, in_ptr, in_size_u32);
+        auto H_approx = ans_options_H_approx(in_ptr, in_size_u32,
+            ans_sint_compress, ans_sint_decompress<t_prefetch>);
+        return ans_sint_compress(
+            out_ptr, out_size_u8, in_ptr, in_size_u32, H_approx);
+    }
+    static void decode(const uint8_t* in_ptr, size_t in_size_u8,
+        uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
+    {
+        ans_sint_decompress<t_prefetch>(
+            out_ptr, out_size_u32, in_ptr, in_size_u8);
+    }
+};
+
+struct ANSsmsb {
+    static std::string name()
+    {
+        return std::string("ANSsmsb-") + ans_options_H_approx_name();
+    }
+
+    static size_t encode(const uint32_t* in_ptr, size_t in_size_u32,
+        uint8_t* out_ptr, size_t out_size_u8, uint8_t* buf = NULL)
+    {
+        auto H_approx = ans_options_H_approx(
+            in_ptr, in_size_u32, ans_smsb_compress, ans_smsb_decompress);
+        return ans_smsb_compress(
+            out_ptr, out_size_u8, in_ptr, in_size_u32, H_approx);
     }
     static void decode(const uint8_t* in_ptr, size_t in_size_u8,
         uint32_t* out_ptr, size_t out_size_u32, uint8_t* buf = NULL)
@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* Zero run-length transform used as a front end to the entropy coders.
+
+   The input is split into the non-zero values (literals) and, for every
+   literal, the number of zeros in front of it; zeros after the last literal
+   are counted separately. Both streams are coded independently. For
+   geometric run lengths this representation loses nothing under an order-0
+   model, while the number of decode steps drops to two per literal. The
+   decoder writes runs with wide stores: short runs are covered by a fixed
+   32 byte store and only longer ones need a memset.
+*/
+
+#include <cstring>
+
+namespace rle_constants {
+const uint32_t SHORT_RUN = 8;
+}
+
+size_t rle_count_zeros(const uint32_t* in_u32, size_t n)
+{
+    size_t zeros = 0;
+    for (size_t i = 0; i < n; i++)
+        zeros += (in_u32[i] == 0);
+    return zeros;
+}
+
+// returns the number of zeros after the last literal
+size_t rle_transform(const uint32_t* in_u32, size_t n, uint32_t* literals,
+    uint32_t* runs, size_t* num_literals)
+{
+    size_t nl = 0;
+    uint32_t run = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = in_u32[i];
+        if (x == 0) {
+            run++;
+        } else {
+            literals[nl] = x;
+            runs[nl] = run;
+            nl++;
+            run = 0;
+        }
+    }
+    *num_literals = nl;
+    return run;
+}
+
+void rle_expand(const uint32_t* literals, const uint32_t* runs,
+    size_t num_literals, size_t trailing_zeros, uint32_t* out_u32,
+    size_t n)
+{
+    const uint32_t S = rle_constants::SHORT_RUN;
+    uint32_t* out_end = out_u32 + n;
+    for (size_t i = 0; i < num_literals; i++) {
+        uint32_t run = runs[i];
+        if (run <= S && out_end - out_u32 >= S) {
+            memset(out_u32, 0, S * sizeof(uint32_t));
+        } else {
+            memset(out_u32, 0, run * sizeof(uint32_t));
+        }
+        out_u32 += run;
+        *out_u32++ = literals[i];
+    }
+    memset(out_u32, 0, trailing_zeros * sizeof(uint32_t));
+}
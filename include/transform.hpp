@@ -0,0 +1,121 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+/* Delta and zigzag front ends.
+
+   delta_encode turns a non-decreasing list into its d-gaps, zigzag_encode
+   maps signed values (two's complement in a uint32_t) to small unsigned
+   ones. The inverse transforms are output policies for the decode loops
+   of the ANS codecs: the loop hands every group of four decoded symbols
+   to store4, which writes the final values. delta_output computes the
+   prefix sum of the group in an SSE register and adds the running total,
+   zigzag_output undoes the mapping on all four lanes, so the values are
+   written once and never read back. identity_output stores the symbols
+   unchanged and is the default of the decode loops.
+
+   Both transforms can leave the domain of the codecs behind them, which
+   store values in the 30 bit field of their decode entries: zigzag
+   doubles the magnitude, so any |x| >= 2^29 maps to 2^30 or more, and a
+   gap of 2^30 or more (or any decrease) does too. The front ends check
+   the transformed values with transform_fits and otherwise code the
+   input unchanged.
+*/
+
+#include <algorithm>
+#include <emmintrin.h>
+
+namespace transform_constants {
+// the largest value in the 30 bit value field of the ANS decode entries
+const uint32_t MAX_VALUE = (1U << 30) - 1;
+}
+
+// whether all n values fit the codecs behind the front ends
+bool transform_fits(const uint32_t* in_u32, size_t n)
+{
+    uint32_t max_value = 0;
+    for (size_t i = 0; i < n; i++)
+        max_value = std::max(max_value, in_u32[i]);
+    return max_value <= transform_constants::MAX_VALUE;
+}
+
+void delta_encode(const uint32_t* in_u32, size_t n, uint32_t* out_u32)
+{
+    uint32_t prev = 0;
+    for (size_t i = 0; i < n; i++) {
+        out_u32[i] = in_u32[i] - prev;
+        prev = in_u32[i];
+    }
+}
+
+void zigzag_encode(const uint32_t* in_u32, size_t n, uint32_t* out_u32)
+{
+    for (size_t i = 0; i < n; i++) {
+        out_u32[i] = (in_u32[i] << 1) ^ uint32_t(int32_t(in_u32[i]) >> 31);
+    }
+}
+
+struct identity_output {
+    void store4(uint32_t* out_u32, uint32_t a, uint32_t b, uint32_t c,
+        uint32_t d)
+    {
+        out_u32[0] = a;
+        out_u32[1] = b;
+        out_u32[2] = c;
+        out_u32[3] = d;
+    }
+    void store(uint32_t* out_u32, uint32_t x) { *out_u32 = x; }
+};
+
+struct delta_output {
+    // the last value written, in all four lanes
+    __m128i total = _mm_setzero_si128();
+
+    void store4(uint32_t* out_u32, uint32_t a, uint32_t b, uint32_t c,
+        uint32_t d)
+    {
+        __m128i v = _mm_setr_epi32(a, b, c, d);
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi32(v, total);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_u32), v);
+        total = _mm_shuffle_epi32(v, 0xFF);
+    }
+    void store(uint32_t* out_u32, uint32_t x)
+    {
+        uint32_t value = uint32_t(_mm_cvtsi128_si32(total)) + x;
+        *out_u32 = value;
+        total = _mm_set1_epi32(value);
+    }
+};
+
+struct zigzag_output {
+    void store4(uint32_t* out_u32, uint32_t a, uint32_t b, uint32_t c,
+        uint32_t d)
+    {
+        __m128i v = _mm_setr_epi32(a, b, c, d);
+        __m128i sign = _mm_sub_epi32(
+            _mm_setzero_si128(), _mm_and_si128(v, _mm_set1_epi32(1)));
+        v = _mm_xor_si128(_mm_srli_epi32(v, 1), sign);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_u32), v);
+    }
+    void store(uint32_t* out_u32, uint32_t x)
+    {
+        *out_u32 = (x >> 1) ^ (0 - (x & 1));
+    }
+};
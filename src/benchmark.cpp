@@ -16,6 +16,7 @@
 // under the License.
 
 #include <iostream>
+#include <numeric>
 #include <vector>
 
 #include "cutil.hpp"
@@ -39,6 +40,13 @@ po::variables_map parse_cmdargs(int argc, char const* argv[])
     desc.add_options()
         ("help,h", "produce help message")
         ("text,t", "text input (default is uint32_t binary)")
+        ("table-budget,b", po::value<size_t>(),
+            "decode table budget of the ANS codecs in KiB (default none)")
+        ("approx,a", po::value<uint32_t>(),
+            "approximation ratio of ANSsint/ANSsmsb, 0 searches it "
+            "(default all of Fig. 12)")
+        ("decode-target", po::value<double>()->default_value(0),
+            "decode ns/int the ratio search has to meet (default fastest)")
         ("input,i",po::value<std::string>()->required(), "the input dir");
     // clang-format on
     try {
@@ -125,6 +133,15 @@ int main(int argc, char const* argv[])
     if (cmdargs.count("text")) {
         input_file_filter = boost::regex(".*\\.txt");
     }
+    ans_options::decode_target_ns = cmdargs["decode-target"].as<double>();
+    std::vector<uint32_t> H_approx_ratios(
+        H_APPROX_RATIOS.begin(), H_APPROX_RATIOS.end());
+    if (cmdargs.count("approx")) {
+        H_approx_ratios = { cmdargs["approx"].as<uint32_t>() };
+    }
+    if (cmdargs.count("table-budget")) {
+        ans_options::table_budget = cmdargs["table-budget"].as<size_t>() << 10;
+    }
 
     // single file also works!
     boost::filesystem::path p(input_dir);
@@ -153,28 +170,47 @@ int main(int argc, char const* argv[])
         }
         std::string short_name = i->path().stem().string();
 
-        run<ANSsmsb<1>>(input_u32s, short_name);
-        run<ANSsmsb<5>>(input_u32s, short_name);
-        run<ANSsmsb<10>>(input_u32s, short_name);
-        run<ANSsmsb<20>>(input_u32s, short_name);
-        run<ANSsmsb<40>>(input_u32s, short_name);
-        run<ANSsmsb<80>>(input_u32s, short_name);
-        run<ANSsmsb<160>>(input_u32s, short_name);
-        run<ANSsmsb<320>>(input_u32s, short_name);
-
-        run<ANSsint<1>>(input_u32s, short_name);
-        run<ANSsint<5>>(input_u32s, short_name);
-        run<ANSsint<10>>(input_u32s, short_name);
-        run<ANSsint<20>>(input_u32s, short_name);
-        run<ANSsint<40>>(input_u32s, short_name);
-        run<ANSsint<80>>(input_u32s, short_name);
-        run<ANSsint<160>>(input_u32s, short_name);
-        run<ANSsint<320>>(input_u32s, short_name);
+        // the prefix sums of the input, their d-gaps are the input again
+        std::vector<uint32_t> input_psums(input_u32s.size());
+        std::partial_sum(
+            input_u32s.begin(), input_u32s.end(), input_psums.begin());
+        // the differences of neighbouring values, signed input for ZigZag
+        std::vector<uint32_t> input_diffs(input_u32s.size());
+        std::adjacent_difference(
+            input_u32s.begin(), input_u32s.end(), input_diffs.begin());
+
+        for (auto H_approx : H_approx_ratios) {
+            ans_options::H_approx = H_approx;
+            run<ANSsmsb>(input_u32s, short_name);
+        }
+        for (auto H_approx : H_approx_ratios) {
+            ans_options::H_approx = H_approx;
+            run<ANSsint<>>(input_u32s, short_name);
+        }
 
         run<ANSmsb>(input_u32s, short_name);
+        run<ANSmsb_compact>(input_u32s, short_name);
+        run<ANSrmsb>(input_u32s, short_name);
+        run<ANSmsb_ex>(input_u32s, short_name);
+        run<ANSmsb_param>(input_u32s, short_name);
+        run<ANSmsb_o1<16>>(input_u32s, short_name);
+        run<ANSmsb_o1<64>>(input_u32s, short_name);
+        run<ANSpair<1>>(input_u32s, short_name);
+        run<ANSpair<16>>(input_u32s, short_name);
+        run<ANSmsb_pair>(input_u32s, short_name);
+        run<RLE<ANSint>>(input_u32s, short_name);
+        run<RLE<ANSmsb>>(input_u32s, short_name);
+        run<Delta<ANSmsb>>(input_psums, short_name + "-psum");
+        run<Delta<ANSfold<1>>>(input_psums, short_name + "-psum");
+        run<ZigZag<ANSfold<1>>>(input_diffs, short_name + "-diff");
         run<ANSint>(input_u32s, short_name);
+        run<ANSint_esc<256>>(input_u32s, short_name);
         run<shuff>(input_u32s, short_name);
         run<arith>(input_u32s, short_name);
+        run<arith_lookup>(input_u32s, short_name);
+        run<arith_multi<2>>(input_u32s, short_name);
+        run<arith_multi<4>>(input_u32s, short_name);
+        run<arith_adaptive>(input_u32s, short_name);
 
         run<ANSfold<1>>(input_u32s, short_name);
         run<ANSfold<2>>(input_u32s, short_name);
@@ -190,11 +226,16 @@ int main(int argc, char const* argv[])
         run<ANSfold<6>>(input_u32s, short_name);
         run<ANSfold<7>>(input_u32s, short_name);
         run<ANSfold<8>>(input_u32s, short_name);
+        run<ANSfold<1, 4>>(input_u32s, short_name);
+        run<ANSfold<2, 4>>(input_u32s, short_name);
+        run<ANSfold<4, 4>>(input_u32s, short_name);
+        run<ANSfold<1, 16>>(input_u32s, short_name);
 
         run<shuff>(input_u32s, short_name);
 
         run<vbyte>(input_u32s, short_name);
         run<optpfor<128>>(input_u32s, short_name);
+        run<optpforANS>(input_u32s, short_name);
         run<streamvbyte>(input_u32s, short_name);
         run<huffzero>(input_u32s, short_name);
         run<fse>(input_u32s, short_name);
@@ -202,7 +243,13 @@ int main(int argc, char const* argv[])
         run<streamvbytefse>(input_u32s, short_name);
         run<vbytehuffzero>(input_u32s, short_name);
         run<streamvbyteANS>(input_u32s, short_name);
+        run<vbyteANSx32<streamvbyte>>(input_u32s, short_name);
+        run<streamvbyteANSdual<false>>(input_u32s, short_name);
+        run<streamvbyteANSdual<true>>(input_u32s, short_name);
         run<vbyteANS>(input_u32s, short_name);
+        run<vbyteANSx32<vbyte>>(input_u32s, short_name);
+        run<vbyteANS1<1>>(input_u32s, short_name);
+        run<vbyteANS1<2>>(input_u32s, short_name);
     }
 
     return EXIT_SUCCESS;
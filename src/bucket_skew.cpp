@@ -59,9 +59,9 @@ po::variables_map parse_cmdargs(int argc, char const* argv[])
     return vm;
 }
 
-template <uint32_t fidelity> uint32_t compute_bucket(uint32_t x)
+template <uint32_t fidelity, uint32_t radix>
+uint32_t compute_bucket(uint32_t x)
 {
-    const uint32_t radix = 8;
     uint32_t radix_mask = ((1 << radix) - 1);
     size_t offset = 0;
     size_t thres = 1 << (fidelity + radix - 1);
@@ -83,12 +83,12 @@ double kl_divergance(std::vector<double>& P, std::vector<double>& Q)
     return -kl;
 }
 
-template <uint32_t fidelity>
+template <uint32_t fidelity, uint32_t radix>
 void compute_skew(std::vector<uint32_t>& input, std::string name)
 {
     std::vector<uint32_t> bucket_map(1 << 27);
     for (size_t i = 0; i < bucket_map.size(); i++) {
-        bucket_map[i] = compute_bucket<fidelity>(i);
+        bucket_map[i] = compute_bucket<fidelity, radix>(i);
     }
     std::vector<uint32_t> bucket_sizes;
     std::vector<uint32_t> bucket_min;
@@ -114,13 +114,13 @@ void compute_skew(std::vector<uint32_t>& input, std::string name)
 
     std::vector<uint32_t> bucket_usage(bucket_sizes.size());
     for (size_t i = 0; i < input.size(); i++) {
-        auto bucket_id = compute_bucket<fidelity>(input[i]);
+        auto bucket_id = compute_bucket<fidelity, radix>(input[i]);
         bucket_usage[bucket_id]++;
     }
 
     std::vector<std::vector<double>> real_dists(bucket_sizes.size());
     for (size_t i = 0; i < input.size(); i++) {
-        auto bucket_id = compute_bucket<fidelity>(input[i]);
+        auto bucket_id = compute_bucket<fidelity, radix>(input[i]);
         if (real_dists[bucket_id].size() == 0)
             real_dists[bucket_id].resize(bucket_sizes[bucket_id]);
         auto bucket_offset = input[i] - bucket_min[bucket_id];
@@ -140,8 +140,8 @@ void compute_skew(std::vector<uint32_t>& input, std::string name)
             }
             bits_real /= double(bucket_usage[i]);
             usage_cum_sum += bucket_usage[i];
-            std::cout << name << ";" << i << ";" << fidelity << ";"
-                      << bucket_min[i] << ";" << bucket_max[i] << ";"
+            std::cout << name << ";" << i << ";" << fidelity << ";" << radix
+                      << ";" << bucket_min[i] << ";" << bucket_max[i] << ";"
                       << bucket_sizes[i] << ";" << bucket_usage[i] << ";"
                       << usage_cum_sum << ";" << input.size() << ";"
                       << (bits_uniform - bits_real) << std::endl;
@@ -186,12 +186,26 @@ int main(int argc, char const* argv[])
         }
         std::string short_name = i->path().stem().string();
 
-        compute_skew<1>(input_u32s, short_name);
-        compute_skew<2>(input_u32s, short_name);
-        compute_skew<3>(input_u32s, short_name);
-        compute_skew<4>(input_u32s, short_name);
-        compute_skew<5>(input_u32s, short_name);
-        compute_skew<6>(input_u32s, short_name);
+        compute_skew<1, 4>(input_u32s, short_name);
+        compute_skew<2, 4>(input_u32s, short_name);
+        compute_skew<3, 4>(input_u32s, short_name);
+        compute_skew<4, 4>(input_u32s, short_name);
+        compute_skew<5, 4>(input_u32s, short_name);
+        compute_skew<6, 4>(input_u32s, short_name);
+
+        compute_skew<1, 8>(input_u32s, short_name);
+        compute_skew<2, 8>(input_u32s, short_name);
+        compute_skew<3, 8>(input_u32s, short_name);
+        compute_skew<4, 8>(input_u32s, short_name);
+        compute_skew<5, 8>(input_u32s, short_name);
+        compute_skew<6, 8>(input_u32s, short_name);
+
+        compute_skew<1, 16>(input_u32s, short_name);
+        compute_skew<2, 16>(input_u32s, short_name);
+        compute_skew<3, 16>(input_u32s, short_name);
+        compute_skew<4, 16>(input_u32s, short_name);
+        compute_skew<5, 16>(input_u32s, short_name);
+        compute_skew<6, 16>(input_u32s, short_name);
     }
 
     return EXIT_SUCCESS;
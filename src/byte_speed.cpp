@@ -0,0 +1,165 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Decode speed in GB/s of the byte coders on the vbyte and streamvbyte
+// output of each input file
+
+#include <iostream>
+#include <vector>
+
+#include "cutil.hpp"
+#include "methods.hpp"
+#include "util.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/regex.hpp>
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+const int NUM_RUNS = 5;
+
+po::variables_map parse_cmdargs(int argc, char const* argv[])
+{
+    po::variables_map vm;
+    po::options_description desc("Allowed options");
+    // clang-format off
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("text,t", "text input (default is uint32_t binary)")
+        ("input,i",po::value<std::string>()->required(), "the input dir");
+    // clang-format on
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help")) {
+            std::cout << desc << "\n";
+            exit(EXIT_SUCCESS);
+        }
+        po::notify(vm);
+    } catch (const po::required_option& e) {
+        std::cout << desc;
+        std::cerr << "Missing required option: " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    } catch (po::error& e) {
+        std::cout << desc;
+        std::cerr << "Error parsing cmdargs: " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return vm;
+}
+
+template <class t_compress, class t_decompress>
+void run(const std::vector<uint8_t>& input, std::string input_name,
+    std::string coder_name, t_compress compress, t_decompress decompress)
+{
+    std::vector<uint8_t> encoded_data(input.size() * 2 + 4096);
+    size_t encoded_bytes = compress(
+        encoded_data.data(), encoded_data.size(), input.data(), input.size());
+
+    std::vector<uint8_t> recover(input.size());
+    size_t decode_time_ns_min = std::numeric_limits<size_t>::max();
+    for (int i = 0; i < NUM_RUNS; i++) {
+        auto start_decode = std::chrono::high_resolution_clock::now();
+        decompress(recover.data(), recover.size(), encoded_data.data(),
+            encoded_bytes);
+        auto stop_decode = std::chrono::high_resolution_clock::now();
+        auto decode_time_ns = stop_decode - start_decode;
+        decode_time_ns_min
+            = std::min((size_t)decode_time_ns.count(), decode_time_ns_min);
+    }
+    REQUIRE_EQUAL(input, recover, coder_name);
+
+    double bits_per_byte = double(encoded_bytes * 8) / double(input.size());
+    double gb_per_s = double(input.size()) / double(decode_time_ns_min);
+    printf("%25.25s\t\t%15u\t\t%18.18s\t\t%2.4f\t\t%2.3f\n",
+        input_name.c_str(), (uint32_t)input.size(), coder_name.c_str(),
+        bits_per_byte, gb_per_s);
+    fflush(stdout);
+}
+
+void run_coders(const std::vector<uint8_t>& input, std::string input_name)
+{
+    run(input, input_name, "ans_byte", ans_byte_compress,
+        [](void* dst, size_t n, const void* src, size_t size) {
+            ans_byte_decompress(dst, n, src, size);
+        });
+    run(input, input_name, "ans_byte_x32-scalar", ans_byte_x32_compress,
+        [](void* dst, size_t n, const void* src, size_t size) {
+            ans_byte_x32_decompress(dst, n, src, size, x32_backend::SCALAR);
+        });
+    if (__builtin_cpu_supports("avx2")) {
+        run(input, input_name, "ans_byte_x32-avx2", ans_byte_x32_compress,
+            [](void* dst, size_t n, const void* src, size_t size) {
+                ans_byte_x32_decompress(dst, n, src, size, x32_backend::AVX2);
+            });
+    }
+}
+
+int main(int argc, char const* argv[])
+{
+    auto cmdargs = parse_cmdargs(argc, argv);
+    auto input_dir = cmdargs["input"].as<std::string>();
+
+    boost::regex input_file_filter(".*\\.u32");
+    if (cmdargs.count("text")) {
+        input_file_filter = boost::regex(".*\\.txt");
+    }
+
+    // single file also works!
+    boost::filesystem::path p(input_dir);
+    if (boost::filesystem::is_regular_file(p)) {
+        input_file_filter = boost::regex(p.filename().string());
+        input_dir = p.parent_path().string();
+    }
+
+    boost::filesystem::directory_iterator
+        end_itr; // Default ctor yields past-the-end
+    for (boost::filesystem::directory_iterator i(input_dir); i != end_itr;
+         ++i) {
+        if (!boost::filesystem::is_regular_file(i->status()))
+            continue;
+        boost::smatch what;
+        if (!boost::regex_match(
+                i->path().filename().string(), what, input_file_filter))
+            continue;
+
+        std::string file_name = i->path().string();
+        std::vector<uint32_t> input_u32s;
+        if (cmdargs.count("text")) {
+            input_u32s = read_file_text(file_name);
+        } else {
+            input_u32s = read_file_u32(file_name);
+        }
+        std::string short_name = i->path().stem().string();
+
+        std::vector<uint8_t> bytes(input_u32s.size() * 8 + 4096);
+        size_t vbyte_bytes = vbyte::encode(input_u32s.data(),
+            input_u32s.size(), bytes.data(), bytes.size());
+        run_coders(std::vector<uint8_t>(bytes.begin(),
+                       bytes.begin() + vbyte_bytes),
+            short_name + "-vbyte");
+        size_t svb_bytes = streamvbyte::encode(input_u32s.data(),
+            input_u32s.size(), bytes.data(), bytes.size());
+        run_coders(
+            std::vector<uint8_t>(bytes.begin(), bytes.begin() + svb_bytes),
+            short_name + "-streamvbyte");
+    }
+
+    return EXIT_SUCCESS;
+}
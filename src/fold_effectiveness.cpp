@@ -87,8 +87,28 @@ void run(std::vector<uint32_t>& input, std::string input_name)
     double encode_IPS = compute_ips(input.size(), encoding_time_ns_min);
     double enc_ns_per_int = double(encoding_time_ns_min) / double(input.size());
 
-    // (4) output stats
-    printf("(%s,%2.4f)\n", t_compressor::name().c_str(), BPI);
+    // (2) decode
+    encoded_data.resize(encoded_bytes);
+    std::vector<uint32_t> recover(input.size());
+    size_t decode_time_ns_min = std::numeric_limits<size_t>::max();
+    for (int i = 0; i < NUM_RUNS; i++) {
+        auto start_decode = std::chrono::high_resolution_clock::now();
+        t_compressor::decode(encoded_data.data(), encoded_data.size(),
+            recover.data(), recover.size(), tmp_buf.data());
+        auto stop_decode = std::chrono::high_resolution_clock::now();
+        auto decode_time_ns = stop_decode - start_decode;
+        decode_time_ns_min
+            = std::min((size_t)decode_time_ns.count(), decode_time_ns_min);
+    }
+    double dec_ns_per_int = double(decode_time_ns_min) / double(input.size());
+
+    // (3) verify
+    REQUIRE_EQUAL(
+        input.data(), recover.data(), input.size(), t_compressor::name());
+
+    // (4) output stats, the decode time as a comment after the coordinate
+    printf("(%s,%2.4f) %% %2.3f ns/int\n", t_compressor::name().c_str(), BPI,
+        dec_ns_per_int);
     fflush(stdout);
 }
 
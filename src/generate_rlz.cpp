@@ -196,15 +196,24 @@ int main(int argc, char const* argv[])
         }
     }
 
+    /* interleaved (len, off) tuples for the paired stream codec */
+    std::vector<uint32_t> pairs;
+    for (size_t i = 0; i < lens.size(); i++) {
+        pairs.push_back(lens[i]);
+        pairs.push_back(offsets[i]);
+    }
+
     {
         timer t("(5) write RLZ file");
         if (write_text) {
 
             write_file_text(lens, file_name + "-FLENS.txt");
             write_file_text(offsets, file_name + "-FOFFSETS.txt");
+            write_file_text(pairs, file_name + "-FPAIRS.txt");
         } else {
             write_file_u32(lens, file_name + "-FLENS.u32");
             write_file_u32(offsets, file_name + "-FOFFSETS.u32");
+            write_file_u32(pairs, file_name + "-FPAIRS.u32");
         }
     }
 }
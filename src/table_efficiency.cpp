@@ -172,7 +172,12 @@ int main(int argc, char const* argv[])
     run<optpfor<128>>(inputs);
     run<shuff>(inputs);
     run<arith>(inputs);
+    run<arith_multi<4>>(inputs);
     run<ANSint>(inputs);
+    run<ANSint_prefetch<PREFETCH_OFF>>(inputs);
+    run<ANSint_prefetch<PREFETCH_ON>>(inputs);
+    run<ANSsint<>>(inputs);
+    run<ANSsint<PREFETCH_OFF>>(inputs);
     run<ANSfold<1>>(inputs);
     run<ANSfold<5>>(inputs);
     run<ANSrfold<1>>(inputs);